@@ -4,87 +4,342 @@
  */
 
 #include "bfibe.h"
+#include "api.h"
+#include <openssl/rand.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <openssl/rand.h>
+#include <unistd.h>
+
+/*
+ * Benchmark harness for the IBE library.
+ *
+ * Measures setup, key generation, parameter serialization (text and
+ * binary), encryption and decryption across message sizes, shard
+ * combination, and multi-threaded encrypt throughput. Timing uses the
+ * monotonic wall clock and reports p50/p95/p99 so tail behavior is
+ * visible; pass -j for machine-readable JSON suitable for tracking
+ * regressions between releases.
+ *
+ * Usage: benchmark [-l level] [-n reps] [-w warmup] [-i identities]
+ *                  [-s size,size,...] [-t threads] [-j]
+ */
+
+static int SECURITY_LEVEL = 3;
+static int REPS = 200;
+static int WARMUP = 20;
+static int IDENTITY_COUNT = 100;
+static int THREADS = 0; // 0 = one per core
+static int JSON_OUTPUT = 0;
+
+static size_t MESSAGE_SIZES[16] = {32, 1024, 16384};
+static int MESSAGE_SIZE_COUNT = 3;
+
+static int json_results = 0;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
 
-// 256-bit AES key
-const int PAYLOAD_BYTES = 32;
-const int REPS = 100;
-char *EMAIL = "alice@example.com";
+static int cmp_double(const void *a, const void *b) {
+  double d = *(const double *)a - *(const double *)b;
+  return (d > 0) - (d < 0);
+}
 
-double benchmark_paramgen(BFPublicParameters *params, mpz_t s, uint8_t level) {
-  clock_t start, end;
+static double percentile(double *sorted, int n, double p) {
+  int index = (int)(p / 100.0 * (n - 1) + 0.5);
+  return sorted[index];
+}
 
-  start = clock();
-  bf_setup(params, s, level);
-  end = clock();
+static void report(const char *name, size_t size, double *samples, int n) {
+  qsort(samples, n, sizeof(*samples), cmp_double);
+
+  double sum = 0;
+  for (int i = 0; i < n; i++) {
+    sum += samples[i];
+  }
+  double mean = sum / n;
+  double p50 = percentile(samples, n, 50);
+  double p95 = percentile(samples, n, 95);
+  double p99 = percentile(samples, n, 99);
 
-  return ((double) end - start) / (double) CLOCKS_PER_SEC;
+  if (JSON_OUTPUT) {
+    printf("%s\n  {\"name\": \"%s\", \"size\": %zu, \"reps\": %d, "
+           "\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, "
+           "\"p99_ms\": %.4f}",
+           json_results ? "," : "", name, size, n, mean, p50, p95, p99);
+    json_results++;
+  } else {
+    printf("%-24s size=%-6zu n=%-5d mean=%8.4fms p50=%8.4fms p95=%8.4fms "
+           "p99=%8.4fms\n",
+           name, size, n, mean, p50, p95, p99);
+  }
+}
+
+static void report_throughput(const char *name, size_t size, int threads,
+                              double ops_per_sec) {
+  if (JSON_OUTPUT) {
+    printf("%s\n  {\"name\": \"%s\", \"size\": %zu, \"threads\": %d, "
+           "\"ops_per_sec\": %.1f}",
+           json_results ? "," : "", name, size, threads, ops_per_sec);
+    json_results++;
+  } else {
+    printf("%-24s size=%-6zu threads=%-3d %10.1f ops/sec\n", name, size,
+           threads, ops_per_sec);
+  }
 }
 
-int main() {
-  double init_times[5] = {0.0};
-  double encrypt_times[5] = {0.0};
-  double decrypt_times[5] = {0.0};
-
-  // Generate test data to encrypt
-  uint8_t aes_key[PAYLOAD_BYTES];
-  uint8_t decrypted_key[PAYLOAD_BYTES];
-  RAND_bytes(aes_key, PAYLOAD_BYTES);
-
-  // Initialize each security level
-  BFPublicParameters params[5];
-  mpz_t s[5];
-  for(uint8_t i = 0; i < 5; i++) {
-    mpz_init(s[i]);
-    init_times[i] = benchmark_paramgen(&params[i], s[i], i+1);
-  }
-
-  for(uint8_t i = 0; i < 5; i++) {
-    // Generate Alice's public key
-    element_t alicePub;
-    element_init_G2(alicePub, params[i].pairing);
-    bf_generate_public_key(alicePub, &params[i], EMAIL);
-
-    // Generate Alice's private key.
-    element_t alicePK;
-    element_init_G2(alicePK, params[i].pairing);
-    bf_generate_private_key(alicePK, &params[i], s[i], EMAIL);
-
-    // Benchmark encryption
-    clock_t start = clock();
-    for(int j = 0; j < REPS; j++) {
-      BFMessage *encryptedMessage =
-        bf_encrypt(&params[i], alicePub, aes_key, PAYLOAD_BYTES);
-      free(encryptedMessage);
+static char *identity(int i) {
+  static char buf[64];
+  snprintf(buf, sizeof(buf), "client-%d@benchmark", i % IDENTITY_COUNT);
+  return buf;
+}
+
+static void bench_keygen(void *system, void *secret, double *samples) {
+  for (int i = -WARMUP; i < REPS; i++) {
+    double start = now_ms();
+    char *key = generate_private_key(system, secret, identity(i < 0 ? -i : i));
+    double elapsed = now_ms() - start;
+    free(key);
+    if (i >= 0) {
+      samples[i] = elapsed;
     }
-    clock_t end = clock();
-    encrypt_times[i] = ((double)end - start) / (double)CLOCKS_PER_SEC / (double)REPS;
+  }
+  report("generate_private_key", 0, samples, REPS);
+}
 
-    // Encrypt a message for Alice
-    BFMessage *encryptedMessage =
-      bf_encrypt(&params[i], alicePub, aes_key, PAYLOAD_BYTES);
+static void bench_params(void *system, double *samples) {
+  char *param_str = format_system_params(system);
+  for (int i = -WARMUP; i < REPS; i++) {
+    double start = now_ms();
+    void *parsed = parse_system_params(param_str);
+    double elapsed = now_ms() - start;
+    bf_params_clear(parsed);
+    free(parsed);
+    if (i >= 0) {
+      samples[i] = elapsed;
+    }
+  }
+  report("parse_params_text", 0, samples, REPS);
 
-    start = clock();
-    // Decrypt the message
-    for(int j = 0; j < REPS; j++) {
-      bf_decrypt(decrypted_key, &params[i], alicePK, encryptedMessage);
+  int blob_len;
+  void *blob = format_system_params_binary(system, &blob_len);
+  for (int i = -WARMUP; i < REPS; i++) {
+    double start = now_ms();
+    void *parsed = parse_system_params_binary(blob, blob_len);
+    double elapsed = now_ms() - start;
+    bf_params_clear(parsed);
+    free(parsed);
+    if (i >= 0) {
+      samples[i] = elapsed;
     }
-    end = clock();
-    decrypt_times[i] = ((double)end - start) / (double)CLOCKS_PER_SEC / (double)REPS;
+  }
+  report("parse_params_binary", 0, samples, REPS);
+  free(blob);
+  free(param_str);
+}
+
+static void bench_shards(void *system, void *secret, double *samples) {
+  void *shard_system;
+  void *shard_secret;
+  generate_shard(system, &shard_system, &shard_secret);
+
+  for (int i = -WARMUP; i < REPS; i++) {
+    double start = now_ms();
+    void *combined = add_public(system, shard_system);
+    double elapsed = now_ms() - start;
+    bf_params_clear(combined);
+    free(combined);
+    if (i >= 0) {
+      samples[i] = elapsed;
+    }
+  }
+  report("add_public", 0, samples, REPS);
+
+  char *key1 = generate_private_key(system, secret, identity(1));
+  char *key2 = generate_private_key(shard_system, shard_secret, identity(1));
+  for (int i = -WARMUP; i < REPS; i++) {
+    double start = now_ms();
+    char *combined = add_secret(system, key1, key2);
+    double elapsed = now_ms() - start;
+    free(combined);
+    if (i >= 0) {
+      samples[i] = elapsed;
+    }
+  }
+  report("add_secret", 0, samples, REPS);
+  free(key1);
+  free(key2);
+}
+
+static void bench_messages(void *system, void *secret, size_t size,
+                           double *samples) {
+  uint8_t *payload = malloc(size);
+  RAND_bytes(payload, size);
 
-    free(encryptedMessage);
-    element_clear(alicePub);
-    element_clear(alicePK);
+  for (int i = -WARMUP; i < REPS; i++) {
+    int ct_len;
+    double start = now_ms();
+    void *ct = encrypt_ibe(system, identity(i < 0 ? -i : i), payload, size,
+                           &ct_len);
+    double elapsed = now_ms() - start;
+    free(ct);
+    if (i >= 0) {
+      samples[i] = elapsed;
+    }
+  }
+  report("encrypt_ibe", size, samples, REPS);
+
+  char *key_str = generate_private_key(system, secret, identity(0));
+  void *key = parse_private_key(system, key_str);
+  int ct_len;
+  void *ct = encrypt_ibe(system, identity(0), payload, size, &ct_len);
+
+  for (int i = -WARMUP; i < REPS; i++) {
+    int pt_len;
+    double start = now_ms();
+    void *pt = decrypt_ibe(system, key, ct, ct_len, &pt_len);
+    double elapsed = now_ms() - start;
+    free(pt);
+    if (i >= 0) {
+      samples[i] = elapsed;
+    }
+  }
+  report("decrypt_ibe", size, samples, REPS);
+
+  void *context = create_decryption_context(system, key);
+  for (int i = -WARMUP; i < REPS; i++) {
+    int pt_len;
+    double start = now_ms();
+    void *pt = decrypt_ibe_with_context(context, ct, ct_len, &pt_len);
+    double elapsed = now_ms() - start;
+    free(pt);
+    if (i >= 0) {
+      samples[i] = elapsed;
+    }
+  }
+  report("decrypt_ibe_context", size, samples, REPS);
+  free_decryption_context(context);
+
+  free(ct);
+  free(key_str);
+  free(payload);
+}
+
+static void bench_throughput(void *system, size_t size) {
+  int threads = THREADS > 0 ? THREADS : sysconf(_SC_NPROCESSORS_ONLN);
+  int count = REPS;
+
+  uint8_t *payload = malloc(size);
+  RAND_bytes(payload, size);
+
+  char **addresses = calloc(count, sizeof(*addresses));
+  void **messages = calloc(count, sizeof(*messages));
+  int *lengths = calloc(count, sizeof(*lengths));
+  void **outputs = calloc(count, sizeof(*outputs));
+  int *output_lengths = calloc(count, sizeof(*output_lengths));
+  for (int i = 0; i < count; i++) {
+    addresses[i] = strdup(identity(i));
+    messages[i] = payload;
+    lengths[i] = size;
+  }
+
+  void *engine = create_parallel_engine(system, threads);
+
+  double start = now_ms();
+  int done = parallel_encrypt(engine, addresses, messages, lengths, count,
+                              outputs, output_lengths);
+  double elapsed = now_ms() - start;
+
+  report_throughput("parallel_encrypt", size, threads,
+                    done / (elapsed / 1e3));
+
+  destroy_parallel_engine(engine);
+  for (int i = 0; i < count; i++) {
+    free(addresses[i]);
+    free(outputs[i]);
+  }
+  free(addresses);
+  free(messages);
+  free(lengths);
+  free(outputs);
+  free(output_lengths);
+  free(payload);
+}
+
+static void parse_sizes(char *arg) {
+  MESSAGE_SIZE_COUNT = 0;
+  for (char *tok = strtok(arg, ","); tok && MESSAGE_SIZE_COUNT < 16;
+       tok = strtok(NULL, ",")) {
+    MESSAGE_SIZES[MESSAGE_SIZE_COUNT++] = strtoul(tok, NULL, 10);
+  }
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "l:n:w:i:s:t:j")) != -1) {
+    switch (opt) {
+    case 'l':
+      SECURITY_LEVEL = atoi(optarg);
+      break;
+    case 'n':
+      REPS = atoi(optarg);
+      break;
+    case 'w':
+      WARMUP = atoi(optarg);
+      break;
+    case 'i':
+      IDENTITY_COUNT = atoi(optarg);
+      break;
+    case 's':
+      parse_sizes(optarg);
+      break;
+    case 't':
+      THREADS = atoi(optarg);
+      break;
+    case 'j':
+      JSON_OUTPUT = 1;
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-l level] [-n reps] [-w warmup] [-i identities] "
+              "[-s size,size,...] [-t threads] [-j]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  if (JSON_OUTPUT) {
+    printf("{\"security_level\": %d, \"results\": [", SECURITY_LEVEL);
+  }
+
+  double *samples = calloc(REPS, sizeof(*samples));
+
+  double start = now_ms();
+  void *system;
+  void *secret;
+  generate_system(SECURITY_LEVEL, &system, &secret);
+  double setup_ms = now_ms() - start;
+  report("generate_system", 0, &setup_ms, 1);
+
+  bench_keygen(system, secret, samples);
+  bench_params(system, samples);
+  bench_shards(system, secret, samples);
+
+  for (int s = 0; s < MESSAGE_SIZE_COUNT; s++) {
+    bench_messages(system, secret, MESSAGE_SIZES[s], samples);
+  }
+  for (int s = 0; s < MESSAGE_SIZE_COUNT; s++) {
+    bench_throughput(system, MESSAGE_SIZES[s]);
   }
 
-  for(int i = 0; i < 5; i++) {
-    printf("Security level %d\nModulus bits: %d\nHash bits: %d\n"
-           "Initialize: %f\nEncrypt: %f\nDecrypt: %f\n\n",
-           i+1, params[i].security.n_p, params[i].security.n_q,
-           init_times[i], encrypt_times[i], decrypt_times[i]);
+  if (JSON_OUTPUT) {
+    printf("\n]}\n");
   }
 
+  free(samples);
   return 0;
 }
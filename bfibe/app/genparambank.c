@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include "bfibe.h"
+#include <stdlib.h>
+
+/*
+ * Generates curve parameters for the given security levels and appends
+ * them to a parameter bank file, which bf_setup_from_bank can then use
+ * to create fresh systems without the prime search. Expect the level 4
+ * and 5 entries to take minutes to generate; that is the cost this
+ * bank exists to pay once instead of per deployment.
+ */
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printf("Usage: %s BANKFILE LEVEL [LEVEL...]\n", argv[0]);
+    return 1;
+  }
+
+  for (int i = 2; i < argc; i++) {
+    int level = atoi(argv[i]);
+
+    BFPublicParameters params;
+    mpz_t secret;
+    mpz_init(secret);
+
+    printf("Generating curve for security level %d...\n", level);
+    if (!bf_setup(&params, secret, level)) {
+      printf("Setup failed for level %d.\n", level);
+      return 1;
+    }
+
+    if (!bf_param_bank_add(argv[1], &params)) {
+      printf("Failed to write bank entry for level %d.\n", level);
+      return 1;
+    }
+    printf("Banked level %d.\n", level);
+
+    mpz_clear(secret);
+    bf_params_clear(&params);
+  }
+
+  return 0;
+}
@@ -4,12 +4,57 @@
  */
 
 #include "bfibe.h"
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+
+/*
+ * Generates IBE private keys from param.txt and secret.txt in the
+ * current directory.
+ *
+ * The original one-shot form prints the key for a single identifier.
+ * Batch mode holds the parsed parameters and pairing for the whole run
+ * instead of paying that setup per process spawn, and streams
+ * identity<TAB>key lines to stdout:
+ *
+ *   genprivatekey IDENTIFIER          one key, original output format
+ *   genprivatekey -i                  identities from stdin, one per line
+ *   genprivatekey -p PREFIX -c N      keys for PREFIX-0 .. PREFIX-(N-1)
+ */
+
+static void print_key_line(BFPublicParameters *params, mpz_t secret,
+                           char *identity, element_t privateKey) {
+  bf_generate_private_key(privateKey, params, secret, identity);
+  element_printf("%s\t%B\n", identity, privateKey);
+}
 
 int main(int argc, char** argv) {
-  if (argc != 2) {
-    printf("Usage: %s IDENTIFIER", argv[0]);
+  int from_stdin = 0;
+  char *prefix = NULL;
+  long pattern_count = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "ip:c:")) != -1) {
+    switch (opt) {
+    case 'i':
+      from_stdin = 1;
+      break;
+    case 'p':
+      prefix = optarg;
+      break;
+    case 'c':
+      pattern_count = atol(optarg);
+      break;
+    default:
+      printf("Usage: %s [IDENTIFIER | -i | -p PREFIX -c COUNT]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (!from_stdin && !prefix && optind >= argc) {
+    printf("Usage: %s [IDENTIFIER | -i | -p PREFIX -c COUNT]\n", argv[0]);
+    return 1;
   }
 
   // Read system parameters from file
@@ -31,8 +76,26 @@ int main(int argc, char** argv) {
 
   element_t privateKey;
   element_init_G2(privateKey, params.pairing);
-  bf_generate_private_key(privateKey, &params, secret, argv[1]);
-  element_printf("%s\n%B\n", argv[1], privateKey);
+
+  if (from_stdin) {
+    char line[1024];
+    while (fgets(line, sizeof(line), stdin)) {
+      line[strcspn(line, "\r\n")] = 0;
+      if (!line[0]) {
+        continue;
+      }
+      print_key_line(&params, secret, line, privateKey);
+    }
+  } else if (prefix) {
+    char identity[1024];
+    for (long i = 0; i < pattern_count; i++) {
+      snprintf(identity, sizeof(identity), "%s-%ld", prefix, i);
+      print_key_line(&params, secret, identity, privateKey);
+    }
+  } else {
+    bf_generate_private_key(privateKey, &params, secret, argv[optind]);
+    element_printf("%s\n%B\n", argv[optind], privateKey);
+  }
 
   return 0;
 }
@@ -27,28 +27,57 @@ typedef struct {
   HashFn hashfcn;
 } BFSecurityLevel;
 
+struct BFKeyCache;
+struct BFPairingCore;
+
 /*
  * Stores the public parameters of the Boneh-Franklin
  * IBE system.
+ *
+ * The curve and pairing state lives in a refcounted core shared by
+ * every shard of one system, since shards differ only in P_pub. The
+ * aliased pointers below point into the core so existing call sites
+ * keep reading params->pairing and friends; per-shard state is P_pub,
+ * its preprocessing, and the caches.
  */
 typedef struct {
   BFSecurityLevel security;
 
+  // The shared curve/pairing core and the aliases into it.
+  struct BFPairingCore *core;
+
   // The Elliptic curve and pairing data.
-  pbc_param_t pbc_par;
-  pairing_t pairing;
+  struct pbc_param_s *pbc_par;
+  pairing_ptr pairing;
+
+  // The system generator, in G1.
+  element_ptr P;
 
-  // The public curve elements, in G1
-  element_t P, P_pub;
+  // Fixed-base window table for P, built once when the core is
+  // created or parsed. Encryption computes U = [l]P and decryption
+  // recomputes [l]P for its validity check; both use this table.
+  struct element_pp_s *P_precomp;
+
+  // The order of the cyclic subgroup of G1
+  // Used in encryption/decryption.
+  mpz_ptr q;
+
+  // This shard's public point [s]P, in G1.
+  element_t P_pub;
 
   // During encryption, we pair the public key of the recipient
   // with P_pub. This data structure precomputes some of that,
   // calculation to make encryption faster.
   pairing_pp_t P_pub_precomp;
 
-  // The order of the cyclic subgroup of G1
-  // Used in encryption/decryption.
-  mpz_t q;
+  // Optional LRU cache of identity hash points, used by
+  // bf_generate_public_key. NULL when caching is disabled.
+  struct BFKeyCache *key_cache;
+
+  // When true, new ciphertexts mask W with the parallelizable
+  // counter-mode keystream instead of the RFC 5091 serial hash chain.
+  // Decryption always follows the mode recorded in the ciphertext.
+  bool ctr_keystream;
 } BFPublicParameters;
 
 /*
@@ -66,6 +95,10 @@ typedef struct {
 
   // A message-length bag of bytes
   uint8_t *W;
+
+  // True if W was masked with the counter-mode keystream rather than
+  // the legacy serial hash chain. Recorded in the wire format.
+  bool ctr_mode;
 } BFMessage;
 
 /*
@@ -78,6 +111,24 @@ typedef struct {
  */
 bool bf_setup(BFPublicParameters *params, mpz_t s, uint8_t security_level);
 
+/*
+ * Like bf_setup, but loads the curve from a pregenerated parameter
+ * bank instead of searching for primes, dropping fresh-system setup
+ * from minutes to milliseconds at the higher levels. The generator,
+ * secret, and P_pub are still drawn fresh per system.
+ */
+bool bf_setup_from_bank(BFPublicParameters *params, mpz_t s,
+                        uint8_t security_level, const char *bank_path);
+
+/*
+ * The parameter bank file. load returns the banked curve text for a
+ * level (caller frees), or NULL if the level is not banked; add
+ * appends the curve of an existing system, creating the file if
+ * needed. A newer record for the same level supersedes older ones.
+ */
+char *bf_param_bank_load(const char *path, uint8_t security_level);
+bool bf_param_bank_add(const char *path, BFPublicParameters *params);
+
 /**
  * Given a set of public parameters, generate new secret key as s and
  * reset P_pub
@@ -98,6 +149,35 @@ void bf_generate_public_key(element_t public_key, BFPublicParameters *params,
 void bf_generate_private_key(element_t private_key, BFPublicParameters *params,
                              mpz_t s, char *identifier);
 
+/*
+ * Reusable working state for repeated encryptions under one system.
+ * Initializing the group elements and big integers once and reusing
+ * them across a burst of messages avoids paying the setup cost per call.
+ */
+struct BFArena;
+
+typedef struct {
+  BFPublicParameters *params;
+
+  // Scratch member of G2, used to hold the recipient's public key.
+  element_t public_key;
+
+  // Scratch member of GT, used to hold the pairing result.
+  element_t theta;
+
+  // Scratch integer, used to hold the derived exponent l.
+  mpz_t l;
+
+  // Optional arena that V and W buffers are carved from instead of the
+  // heap. When set, messages produced through this scratch must not be
+  // passed to bf_message_free; reset the arena instead.
+  struct BFArena *arena;
+} BFEncryptScratch;
+
+void bf_encrypt_scratch_init(BFEncryptScratch *scratch,
+                             BFPublicParameters *params);
+void bf_encrypt_scratch_clear(BFEncryptScratch *scratch);
+
 /*
  * Allocates and encrypts a message.
  * Should only be used to encrypt session keys.
@@ -106,6 +186,62 @@ void bf_generate_private_key(element_t private_key, BFPublicParameters *params,
 BFMessage *bf_encrypt(BFPublicParameters *params, element_t public_key,
                       uint8_t *m, size_t len);
 
+/*
+ * Encrypts a message into a caller-provided BFMessage, reusing the
+ * group elements in scratch. message->U is initialized and owned by
+ * the message; V and W are allocated. Returns false if randomness
+ * generation fails.
+ */
+bool bf_encrypt_to(BFMessage *message, BFEncryptScratch *scratch,
+                   element_t public_key, uint8_t *m, size_t len);
+
+/*
+ * Like bf_encrypt_to, but addressed by identity. When the system has a
+ * key cache attached, the pairing value e(Q_id, P_pub) is cached per
+ * address, so repeat encryption to the same destination skips the
+ * pairing entirely and costs one GT exponentiation.
+ */
+bool bf_encrypt_to_address(BFMessage *message, BFEncryptScratch *scratch,
+                           char *address, uint8_t *m, size_t len);
+
+/*
+ * Encrypts one message to count recipients, sharing the per-message
+ * randomness, the exponent l, U = [l]P, and the plaintext mask across
+ * all of them. Sharing is safe because l is derived from (rho, t),
+ * which are identical for every recipient; only the pairing and V
+ * differ. Returns a malloc'd array of count ciphertexts, or NULL if
+ * randomness generation fails.
+ */
+BFMessage **bf_encrypt_multi(BFPublicParameters *params,
+                             element_t *public_keys, size_t count, uint8_t *m,
+                             size_t len);
+
+/*
+ * Reusable working state for repeated decryptions under one private key.
+ * Preprocesses the pairing on the private key, so draining a long train
+ * of ciphertexts pays the Miller loop setup once instead of per message.
+ */
+typedef struct {
+  BFPublicParameters *params;
+
+  // Preprocessed pairing data for the private key.
+  pairing_pp_t key_precomp;
+
+  // Scratch member of GT, used to hold the pairing result.
+  element_t theta;
+
+  // Scratch member of G1, used to verify the ciphertext.
+  element_t lP;
+
+  // Scratch integer, used to hold the derived exponent l.
+  mpz_t l;
+} BFDecryptionContext;
+
+void bf_decryption_context_init(BFDecryptionContext *context,
+                                BFPublicParameters *params,
+                                element_t private_key);
+void bf_decryption_context_clear(BFDecryptionContext *context);
+
 /*
  * Decrypts a message into output.
  * output should already be allocated.
@@ -113,6 +249,51 @@ BFMessage *bf_encrypt(BFPublicParameters *params, element_t public_key,
 bool bf_decrypt(uint8_t *output, BFPublicParameters *params,
                 element_t private_key, BFMessage *message);
 
+/*
+ * Decrypts a message into output using a reusable context.
+ */
+bool bf_decrypt_with_context(uint8_t *output, BFDecryptionContext *context,
+                             BFMessage *message);
+
+/*
+ * Like the functions above, but skip the ciphertext consistency check
+ * (step 9 of RFC 5091 decryption, a full fixed-base multiplication).
+ * Only safe when the plaintext is authenticated at a higher layer, e.g.
+ * a GCM tag or a signature on the inner message; a tampered ciphertext
+ * then decrypts to garbage that the outer check rejects. The derived
+ * exponent is left in context->l, so the check can still be run later
+ * with bf_verify.
+ */
+bool bf_decrypt_unverified(uint8_t *output, BFPublicParameters *params,
+                           element_t private_key, BFMessage *message);
+bool bf_decrypt_with_context_unverified(uint8_t *output,
+                                        BFDecryptionContext *context,
+                                        BFMessage *message);
+
+/*
+ * Runs the deferred consistency check for a message against the
+ * exponent currently in context->l: one fixed-base multiplication and a
+ * comparison. Each decryption overwrites context->l, so either verify
+ * before the next decrypt or mpz_set a saved exponent back first.
+ */
+bool bf_verify(BFDecryptionContext *context, BFMessage *message);
+
+/*
+ * Copies public parameters as a new shard over the same refcounted
+ * curve/pairing core: only P_pub and its preprocessing are duplicated,
+ * so the copy costs a pairing_pp_init rather than a pairing rebuild.
+ * Because the pairing is shared, source and copy must not be used from
+ * different threads at once. The clone's key cache starts empty.
+ */
+bool bf_params_clone(BFPublicParameters *dst, BFPublicParameters *src);
+
+/*
+ * Releases everything owned by a set of public parameters, including
+ * the pairing and curve state. Does not free the struct itself. Any
+ * elements initialized against the pairing must be cleared first.
+ */
+void bf_params_clear(BFPublicParameters *params);
+
 /*
  * Export and import the public parameters to/from a file/string.
  */
@@ -121,6 +302,23 @@ bool bf_params_from_file(FILE *in, BFPublicParameters *params);
 size_t bf_params_to_string(uint8_t **out, BFPublicParameters *params);
 bool bf_params_from_string(uint8_t *in, BFPublicParameters *params);
 
+/*
+ * Export and import the public parameters in the versioned binary
+ * format. Much faster to parse and smaller on the wire than the text
+ * form, which remains the default for files and existing callers.
+ */
+size_t bf_params_to_binary(uint8_t **out, BFPublicParameters *params);
+bool bf_params_from_binary(uint8_t *in, size_t len, BFPublicParameters *params);
+
+/*
+ * Save the binary parameter format to a file, and load it back by
+ * memory-mapping the file read-only. Colocated processes that map the
+ * same file share one page-cache copy of the serialized parameters and
+ * only build their own mutable pairing state.
+ */
+size_t bf_params_save(const char *path, BFPublicParameters *params);
+bool bf_params_map(const char *path, BFPublicParameters *params);
+
 /*
  * Export and import a message to/from a file/string/byte array.
  */
@@ -132,7 +330,109 @@ bool bf_message_from_string(uint8_t *in, BFPublicParameters *params,
                             BFMessage *msg);
 size_t bf_message_to_bytes(uint8_t **out, BFPublicParameters *params,
                            BFMessage *msg);
-bool bf_message_from_bytes(uint8_t *in, BFPublicParameters *params,
+bool bf_message_from_bytes(uint8_t *in, size_t len, BFPublicParameters *params,
                            BFMessage *msg);
 
+/*
+ * Like bf_message_from_bytes, but V and W point into the input buffer
+ * instead of being copied out of it. The message borrows the buffer:
+ * keep it alive while the message is in use, and don't pass the
+ * message to bf_message_free. Only U needs clearing.
+ *
+ * Both parsers validate every section, including the embedded
+ * plaintext length, against len before touching the bytes.
+ */
+bool bf_message_from_bytes_view(uint8_t *in, size_t len,
+                                BFPublicParameters *params, BFMessage *msg);
+
+/*
+ * Number of bytes bf_message_to_bytes produces for a plaintext of the
+ * given length under these parameters.
+ */
+size_t bf_message_length_in_bytes(BFPublicParameters *params,
+                                  size_t plaintext_len);
+
+/*
+ * Scatter/gather serialization. bf_message_gather serializes the fixed
+ * header (magic, level byte, length, and U) into the caller's buffer,
+ * which must hold bf_message_header_length bytes, and fills slices
+ * with {header, V, W} so the transport can writev a ciphertext without
+ * assembling a contiguous copy. The V and W slices borrow the message.
+ * Returns the slice count (3), or 0 if the header buffer is too small.
+ */
+typedef struct {
+  uint8_t *base;
+  size_t len;
+} BFMessageSlice;
+
+size_t bf_message_header_length(BFPublicParameters *params);
+size_t bf_message_gather(BFMessageSlice slices[3], uint8_t *header,
+                         size_t capacity, BFPublicParameters *params,
+                         BFMessage *msg);
+
+/*
+ * Serializes a message into a caller-provided buffer.
+ * Returns the number of bytes written, or 0 if capacity is too small.
+ */
+size_t bf_message_to_bytes_into(uint8_t *out, size_t capacity,
+                                BFPublicParameters *params, BFMessage *msg);
+
 void bf_message_free(BFMessage *msg);
+
+/*
+ * Streaming encryption for payloads too large to hold in memory at
+ * once. A fresh random content key is IBE-wrapped into a self-framing
+ * header with a regular bf_encrypt; the payload is then masked with
+ * the counter-mode keystream expanded from that key, in whatever chunk
+ * sizes the caller feeds bf_stream_update. Memory use is constant in
+ * the payload size and ciphertext is produced incrementally.
+ *
+ * The header is covered by the usual decrypt consistency check; the
+ * payload carries no tag of its own, so as with bf_decrypt_unverified
+ * the plaintext must be authenticated at a higher layer.
+ */
+typedef struct {
+  BFPublicParameters *params;
+
+  // hashfcn(content key) followed by a 4-byte block counter; hashed
+  // per block to produce the keystream.
+  uint8_t *block_input;
+
+  // Current keystream block and how much of it has been consumed.
+  uint8_t *block;
+  size_t block_used;
+
+  uint32_t counter;
+} BFStream;
+
+/*
+ * Starts an encryption stream to an address. Writes a malloc'd header
+ * to *header_out and returns its length, or 0 if randomness generation
+ * fails. The header must be transmitted before any payload.
+ */
+size_t bf_stream_encrypt_init(BFStream *stream, BFPublicParameters *params,
+                              char *address, uint8_t **header_out);
+
+/*
+ * Starts a decryption stream from a received header. header may hold
+ * more than the header; *header_used is set to the number of bytes
+ * consumed, and payload bytes begin there. Returns false on a
+ * malformed header or failed consistency check.
+ */
+bool bf_stream_decrypt_init(BFStream *stream, BFPublicParameters *params,
+                            element_t private_key, uint8_t *header,
+                            size_t header_len, size_t *header_used);
+
+/*
+ * Processes len payload bytes; the mask is its own inverse, so the
+ * same call encrypts and decrypts. output may alias input. There is no
+ * final block: stop feeding chunks and clear the stream.
+ */
+void bf_stream_update(BFStream *stream, uint8_t *output, void *input,
+                      size_t len);
+
+/*
+ * Wipes the keystream state and frees it. Safe at any point in the
+ * stream.
+ */
+void bf_stream_clear(BFStream *stream);
@@ -34,18 +34,64 @@ void print_element(const char* label, element_t e) {
     element_snprintf(buf, 4096, "%s: %B", label, e);
 }
 
+/*
+ * Reflection metadata cached once in JNI_OnLoad, instead of a
+ * GetObjectClass + GetFieldID round-trip on every native call.
+ */
+static jclass bonehFranklinClass = NULL;
+static jfieldID systemParamField = NULL;
+static jfieldID privateKeyField = NULL;
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved)
+{
+    JNIEnv *env;
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    jclass cls = (*env)->FindClass(env, "com/sri/csl/prism/crypto/BonehFranklin");
+    if (cls == NULL) {
+        return JNI_ERR;
+    }
+    bonehFranklinClass = (*env)->NewGlobalRef(env, cls);
+    systemParamField = (*env)->GetFieldID(env, cls, "systemParamHandle", "J");
+    privateKeyField = (*env)->GetFieldID(env, cls, "privateKeyHandle", "J");
+    (*env)->DeleteLocalRef(env, cls);
+
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT void JNICALL JNI_OnUnload(JavaVM *vm, void *reserved)
+{
+    JNIEnv *env;
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return;
+    }
+    if (bonehFranklinClass != NULL) {
+        (*env)->DeleteGlobalRef(env, bonehFranklinClass);
+        bonehFranklinClass = NULL;
+        systemParamField = NULL;
+        privateKeyField = NULL;
+    }
+}
+
 BFPublicParameters *getParams(JNIEnv *env, jobject this)
 {
-    jclass cls = (*env)->GetObjectClass(env, this);
-    jfieldID fieldId = (*env)->GetFieldID(env, cls, "systemParamHandle", "J");
-    return (BFPublicParameters *) (*env)->GetLongField(env, this, fieldId);
+    if (systemParamField == NULL) {
+        // Loaded without JNI_OnLoad (e.g. statically linked); resolve lazily.
+        jclass cls = (*env)->GetObjectClass(env, this);
+        systemParamField = (*env)->GetFieldID(env, cls, "systemParamHandle", "J");
+    }
+    return (BFPublicParameters *) (*env)->GetLongField(env, this, systemParamField);
 }
 
 element_t *getPrivateKey(JNIEnv *env, jobject this)
 {
-    jclass cls = (*env)->GetObjectClass(env, this);
-    jfieldID fieldId = (*env)->GetFieldID(env, cls, "privateKeyHandle", "J");
-    return (element_t *) (*env)->GetLongField(env, this, fieldId);
+    if (privateKeyField == NULL) {
+        jclass cls = (*env)->GetObjectClass(env, this);
+        privateKeyField = (*env)->GetFieldID(env, cls, "privateKeyHandle", "J");
+    }
+    return (element_t *) (*env)->GetLongField(env, this, privateKeyField);
 }
 
 JNIEXPORT jlong
@@ -134,9 +180,11 @@ JNICALL Java_com_sri_csl_prism_crypto_BonehFranklin_decryptIBE(
     BFPublicParameters *params = getParams(env, this);
     element_t *privateKey = getPrivateKey(env, this);
     jbyte *cipherBytes = (*env)->GetByteArrayElements(env, cipherText, NULL);
+    jsize cipherLength = (*env)->GetArrayLength(env, cipherText);
 
     BFMessage msg;
-    if (!bf_message_from_bytes((uint8_t *)cipherBytes, params, &msg)) {
+    if (!bf_message_from_bytes((uint8_t *)cipherBytes, cipherLength, params,
+                               &msg)) {
         (*env)->ReleaseByteArrayElements(env, cipherText, cipherBytes, JNI_ABORT);
         return NULL;
     }
@@ -154,3 +202,144 @@ JNICALL Java_com_sri_csl_prism_crypto_BonehFranklin_decryptIBE(
     return retval;
 }
 
+/*
+ * Zero-copy encrypt: the plaintext and ciphertext live in direct
+ * ByteBuffers, so the payload never crosses the JNI boundary as a copy.
+ * Returns the number of ciphertext bytes written, or -1 if the output
+ * buffer is too small or encryption fails.
+ */
+JNIEXPORT jint
+JNICALL Java_com_sri_csl_prism_crypto_BonehFranklin_encryptIBEDirect(
+        JNIEnv *env,
+        jobject this,
+        jstring recipient,
+        jobject messageBuffer,
+        jint messageLength,
+        jobject outputBuffer)
+{
+    BFPublicParameters *params = getParams(env, this);
+    uint8_t *messageBytes = (*env)->GetDirectBufferAddress(env, messageBuffer);
+    uint8_t *outputBytes = (*env)->GetDirectBufferAddress(env, outputBuffer);
+    jlong outputCapacity = (*env)->GetDirectBufferCapacity(env, outputBuffer);
+
+    if (messageBytes == NULL || outputBytes == NULL) {
+        return -1;
+    }
+
+    const char *recipientStr = (*env)->GetStringUTFChars(env, recipient, NULL);
+
+    BFEncryptScratch scratch;
+    bf_encrypt_scratch_init(&scratch, params);
+
+    BFMessage cipherText;
+    jint written = -1;
+    if (bf_encrypt_to_address(&cipherText, &scratch, (char *)recipientStr,
+                              messageBytes, messageLength)) {
+        size_t length = bf_message_to_bytes_into(outputBytes, outputCapacity,
+                                                 params, &cipherText);
+        if (length > 0) {
+            written = (jint)length;
+        }
+
+        free(cipherText.V);
+        free(cipherText.W);
+        element_clear(cipherText.U);
+    }
+
+    bf_encrypt_scratch_clear(&scratch);
+    (*env)->ReleaseStringUTFChars(env, recipient, recipientStr);
+    return written;
+}
+
+/*
+ * Zero-copy decrypt counterpart. The ciphertext is parsed in place out
+ * of its direct ByteBuffer and the plaintext is written straight into
+ * the output buffer. Returns the plaintext length, or -1 on failure.
+ */
+JNIEXPORT jint
+JNICALL Java_com_sri_csl_prism_crypto_BonehFranklin_decryptIBEDirect(
+        JNIEnv *env,
+        jobject this,
+        jobject cipherBuffer,
+        jobject outputBuffer)
+{
+    BFPublicParameters *params = getParams(env, this);
+    element_t *privateKey = getPrivateKey(env, this);
+    uint8_t *cipherBytes = (*env)->GetDirectBufferAddress(env, cipherBuffer);
+    uint8_t *outputBytes = (*env)->GetDirectBufferAddress(env, outputBuffer);
+    jlong cipherCapacity = (*env)->GetDirectBufferCapacity(env, cipherBuffer);
+    jlong outputCapacity = (*env)->GetDirectBufferCapacity(env, outputBuffer);
+
+    if (cipherBytes == NULL || outputBytes == NULL || cipherCapacity < 0) {
+        return -1;
+    }
+
+    BFMessage msg;
+    if (!bf_message_from_bytes_view(cipherBytes, cipherCapacity, params,
+                                    &msg)) {
+        return -1;
+    }
+
+    if ((jlong)msg.length > outputCapacity) {
+        element_clear(msg.U);
+        return -1;
+    }
+
+    jint result = bf_decrypt(outputBytes, params, *privateKey, &msg)
+                      ? (jint)msg.length
+                      : -1;
+    element_clear(msg.U);
+    return result;
+}
+
+/*
+ * Decrypts a whole dropbox poll response in one JNI crossing. One
+ * decryption context is reused across the batch, so the pairing
+ * preprocessing on the private key is paid once rather than per
+ * message. Entries that fail to parse or decrypt come back as null.
+ */
+JNIEXPORT jobjectArray
+JNICALL Java_com_sri_csl_prism_crypto_BonehFranklin_decryptIBEBatch(
+        JNIEnv *env,
+        jobject this,
+        jobjectArray cipherTexts)
+{
+    BFPublicParameters *params = getParams(env, this);
+    element_t *privateKey = getPrivateKey(env, this);
+    jsize count = (*env)->GetArrayLength(env, cipherTexts);
+
+    jclass byteArrayClass = (*env)->FindClass(env, "[B");
+    jobjectArray results = (*env)->NewObjectArray(env, count, byteArrayClass, NULL);
+
+    BFDecryptionContext context;
+    bf_decryption_context_init(&context, params, *privateKey);
+
+    for (jsize i = 0; i < count; i++) {
+        jbyteArray cipherText = (*env)->GetObjectArrayElement(env, cipherTexts, i);
+        jbyte *cipherBytes = (*env)->GetByteArrayElements(env, cipherText, NULL);
+        jsize cipherLength = (*env)->GetArrayLength(env, cipherText);
+
+        BFMessage msg;
+        if (bf_message_from_bytes_view((uint8_t *)cipherBytes, cipherLength,
+                                       params, &msg) &&
+            msg.length <= (size_t)cipherLength) {
+            // msg.length came off the wire; heap-allocate rather than
+            // sizing a stack array with it.
+            uint8_t *msgBytes = malloc(msg.length > 0 ? msg.length : 1);
+            if (bf_decrypt_with_context(msgBytes, &context, &msg)) {
+                jbyteArray result = (*env)->NewByteArray(env, msg.length);
+                (*env)->SetByteArrayRegion(env, result, 0, msg.length, (jbyte *)msgBytes);
+                (*env)->SetObjectArrayElement(env, results, i, result);
+                (*env)->DeleteLocalRef(env, result);
+            }
+            free(msgBytes);
+            element_clear(msg.U);
+        }
+
+        (*env)->ReleaseByteArrayElements(env, cipherText, cipherBytes, JNI_ABORT);
+        (*env)->DeleteLocalRef(env, cipherText);
+    }
+
+    bf_decryption_context_clear(&context);
+    return results;
+}
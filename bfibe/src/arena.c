@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "arena.h"
+
+// Keep every allocation suitably aligned for any scalar type.
+#define ARENA_ALIGNMENT 16
+
+typedef struct BFArenaBlock {
+  struct BFArenaBlock *next;
+  size_t capacity;
+  size_t used;
+  uint8_t bytes[];
+} BFArenaBlock;
+
+struct BFArena {
+  // Block currently being carved from; earlier (smaller) blocks stay
+  // on the list behind it and are retired at reset.
+  BFArenaBlock *current;
+  size_t next_block_size;
+};
+
+static BFArenaBlock *block_new(size_t capacity) {
+  BFArenaBlock *block = malloc(sizeof(*block) + capacity);
+  block->next = NULL;
+  block->capacity = capacity;
+  block->used = 0;
+  return block;
+}
+
+BFArena *bf_arena_new(size_t initial_capacity) {
+  if (initial_capacity < 4096) {
+    initial_capacity = 4096;
+  }
+
+  BFArena *arena = calloc(1, sizeof(*arena));
+  arena->current = block_new(initial_capacity);
+  arena->next_block_size = initial_capacity * 2;
+  return arena;
+}
+
+void *bf_arena_alloc(BFArena *arena, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+  BFArenaBlock *block = arena->current;
+  if (block->used + size > block->capacity) {
+    size_t capacity = arena->next_block_size;
+    if (capacity < size) {
+      capacity = size;
+    }
+    BFArenaBlock *grown = block_new(capacity);
+    grown->next = block;
+    arena->current = grown;
+    arena->next_block_size = capacity * 2;
+    block = grown;
+  }
+
+  void *out = block->bytes + block->used;
+  block->used += size;
+  return out;
+}
+
+void bf_arena_reset(BFArena *arena) {
+  // Keep the newest (largest) block; drop the ones it outgrew.
+  BFArenaBlock *block = arena->current;
+  for (BFArenaBlock *old = block->next; old;) {
+    BFArenaBlock *next = old->next;
+    free(old);
+    old = next;
+  }
+  block->next = NULL;
+  block->used = 0;
+}
+
+void bf_arena_free(BFArena *arena) {
+  if (!arena) {
+    return;
+  }
+  bf_arena_reset(arena);
+  free(arena->current);
+  free(arena);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#pragma once
+#include <stddef.h>
+
+/*
+ * A bump allocator for per-message temporaries in the encrypt/decrypt
+ * hot path. Allocation is a pointer increment; bf_arena_reset reclaims
+ * everything in O(1) between messages or batches. Blocks grow
+ * geometrically, so a warmed-up arena stops touching malloc entirely.
+ *
+ * Not thread-safe; use one arena per thread or per batch.
+ */
+typedef struct BFArena BFArena;
+
+BFArena *bf_arena_new(size_t initial_capacity);
+
+/*
+ * Carve size bytes out of the arena. The memory is uninitialized and
+ * stays valid until the next reset.
+ */
+void *bf_arena_alloc(BFArena *arena, size_t size);
+
+/*
+ * Discard all allocations, keeping the underlying blocks for reuse.
+ */
+void bf_arena_reset(BFArena *arena);
+
+void bf_arena_free(BFArena *arena);
@@ -2,5 +2,29 @@
 #include <stdint.h>
 #include <stdio.h>
 
+/*
+ * Allocating codec. encode returns a NUL-terminated string; decode
+ * returns a buffer and its length. Callers free the result.
+ */
 uint8_t *base64_decode(uint8_t *b64message, size_t *decode_len);
 uint8_t *base64_encode(uint8_t *buffer, size_t length);
+
+/*
+ * Caller-buffer codec. base64_encoded_length gives the string length
+ * (without the terminating NUL) that encode_into will produce; pass a
+ * capacity of at least one more byte. decode_into stops at padding or
+ * the NUL, skips whitespace, and supports dst == b64message since the
+ * output is always shorter than the input. Both return the number of
+ * bytes produced, or 0 on a too-small buffer or invalid input.
+ */
+size_t base64_encoded_length(size_t length);
+size_t base64_encode_into(uint8_t *dst, size_t capacity, const uint8_t *src,
+                          size_t length);
+size_t base64_decode_into(uint8_t *dst, size_t capacity,
+                          const uint8_t *b64message);
+
+/*
+ * The original OpenSSL BIO implementations, kept as a fallback.
+ */
+uint8_t *base64_decode_bio(uint8_t *b64message, size_t *decode_len);
+uint8_t *base64_encode_bio(uint8_t *buffer, size_t length);
@@ -4,8 +4,13 @@
  */
 
 #include "bfibe.h"
+#include "arena.h"
+#include "core.h"
+#include "xor.h"
 #include "hash.h"
+#include "keycache.h"
 #include "security.h"
+#include "stats.h"
 #include <openssl/rand.h>
 #include <string.h>
 
@@ -38,6 +43,36 @@ typedef struct {
   mpz_t h;
 } * a_param_ptr;
 
+/*
+ * Steps 4+ of BFsetup1: everything after the curve exists. Shared by
+ * bf_setup, which generates the curve, and bf_setup_from_bank, which
+ * loads a pregenerated one. Takes over the caller's core reference.
+ */
+static bool setup_from_curve(BFPublicParameters *params, BFPairingCore *core,
+                             mpz_t s) {
+  pairing_init_pbc_param(core->pairing, core->pbc_par);
+
+  // Extract parameters relevant to encryption/decryption
+  a_param_ptr sp = core->pbc_par->data;
+  mpz_init_set(core->q, sp->r);
+
+  // Step 4. Find a suitable generator of F_p
+  element_init_G1(core->P, core->pairing);
+  do {
+    element_random(core->P);
+    element_mul_mpz(core->P, core->P, sp->h);
+  } while (element_is0(core->P));
+  element_pp_init(core->P_precomp, core->P);
+
+  bf_params_attach_core(params, core);
+
+  // Steps 5+ are split off because this part can be used independently
+  // to generate additional system secrets for other key management shards.
+  bf_generate_shard(params, s);
+
+  return true;
+}
+
 /*
  * Implements the BFsetup1 algorithm
  */
@@ -48,28 +83,49 @@ bool bf_setup(BFPublicParameters *params, mpz_t s, uint8_t security_level) {
   if (!setup_security(&(params->security), security_level)) {
     return false;
   }
+  params->key_cache = NULL;
+  params->ctr_keystream = false;
 
   // Step 3. Generate the curve and pairing
-  pbc_param_init_a_gen(params->pbc_par, params->security.n_q,
+  BFPairingCore *core = bf_pairing_core_new();
+  pbc_param_init_a_gen(core->pbc_par, params->security.n_q,
                        params->security.n_p);
-  pairing_init_pbc_param(params->pairing, params->pbc_par);
 
-  // Extract parameters relevant to encryption/decryption
-  a_param_ptr sp = params->pbc_par->data;
-  mpz_init_set(params->q, sp->r);
+  return setup_from_curve(params, core, s);
+}
 
-  // Step 4. Find a suitable generator of F_p
-  element_init_G1(params->P, params->pairing);
-  do {
-    element_random(params->P);
-    element_mul_mpz(params->P, params->P, sp->h);
-  } while (element_is0(params->P));
+/*
+ * Like bf_setup, but loads the curve from a parameter bank instead of
+ * searching for primes. Only the curve is reused: the generator, the
+ * secret, and P_pub are still drawn fresh per system, so systems built
+ * from the same bank entry share no secret material.
+ */
+bool bf_setup_from_bank(BFPublicParameters *params, mpz_t s,
+                        uint8_t security_level, const char *bank_path) {
+  if (!setup_security(&(params->security), security_level)) {
+    return false;
+  }
+  params->key_cache = NULL;
+  params->ctr_keystream = false;
 
-  // Steps 5+ are split off because this part can be used independently
-  // to generate additional system secrets for other key management shards.
-  bf_generate_shard(params, s);
+  char *curve = bf_param_bank_load(bank_path, security_level);
+  if (!curve) {
+    printf("No bank entry for security level %u in %s.\n", security_level,
+           bank_path);
+    return false;
+  }
 
-  return true;
+  BFPairingCore *core = bf_pairing_core_new();
+  int failed = pbc_param_init_set_str(core->pbc_par, curve);
+  free(curve);
+  if (failed) {
+    printf("Failed to parse bank entry for security level %u.\n",
+           security_level);
+    free(core);
+    return false;
+  }
+
+  return setup_from_curve(params, core, s);
 }
 
 /*
@@ -86,10 +142,15 @@ void bf_generate_shard(BFPublicParameters *params, mpz_t s) {
 
   // Generate the public parameter P_pub = [s]P
   element_init_same_as(params->P_pub, params->P);
-  element_mul_mpz(params->P_pub, params->P, s);
+  element_pp_pow(params->P_pub, s, params->P_precomp);
 
   // Precompute information needed to pair with P_pub, used in encryption
   pairing_pp_init(params->P_pub_precomp, params->P_pub, params->pairing);
+
+  // Any cached pairing values were computed against the old P_pub.
+  if (params->key_cache) {
+    bf_key_cache_flush(params->key_cache);
+  }
 }
 
 /*
@@ -97,6 +158,10 @@ void bf_generate_shard(BFPublicParameters *params, mpz_t s) {
  */
 void bf_generate_public_key(element_t public_key, BFPublicParameters *params,
                             char *identifier) {
+  if (params->key_cache) {
+    element_set(public_key, bf_key_cache_get(params->key_cache, identifier));
+    return;
+  }
   hash_to_point(public_key, params, identifier, strlen(identifier));
 }
 
@@ -105,13 +170,57 @@ void bf_generate_public_key(element_t public_key, BFPublicParameters *params,
  */
 void bf_generate_private_key(element_t private_key, BFPublicParameters *params,
                              mpz_t s, char *identifier) {
+  BF_STATS_ENTER(KEYGEN);
   hash_to_point(private_key, params, identifier, strlen(identifier));
   element_mul_mpz(private_key, private_key, s);
+  BF_STATS_LEAVE(KEYGEN);
+}
+
+/*
+ * Initialize the reusable elements and integers used by bf_encrypt_to.
+ */
+void bf_encrypt_scratch_init(BFEncryptScratch *scratch,
+                             BFPublicParameters *params) {
+  scratch->params = params;
+  element_init_G2(scratch->public_key, params->pairing);
+  element_init_GT(scratch->theta, params->pairing);
+  mpz_init(scratch->l);
+  scratch->arena = NULL;
+}
+
+void bf_encrypt_scratch_clear(BFEncryptScratch *scratch) {
+  element_clear(scratch->public_key);
+  element_clear(scratch->theta);
+  mpz_clear(scratch->l);
+  scratch->params = NULL;
 }
 
 BFMessage *bf_encrypt(BFPublicParameters *params, element_t public_key,
                       uint8_t *m, size_t len) {
   BFMessage *message = calloc(1, sizeof(*message));
+
+  BFEncryptScratch scratch;
+  bf_encrypt_scratch_init(&scratch, params);
+  bool ok = bf_encrypt_to(message, &scratch, public_key, m, len);
+  bf_encrypt_scratch_clear(&scratch);
+
+  if (!ok) {
+    free(message);
+    return NULL;
+  }
+
+  return message;
+}
+
+/*
+ * Steps 3-12, shared by all encrypt entry points. Expects scratch->theta
+ * to already hold the recipient's pairing base e(Q_id, P_pub).
+ */
+static bool encrypt_with_theta_base(BFMessage *message,
+                                    BFEncryptScratch *scratch, uint8_t *m,
+                                    size_t len) {
+  BF_STATS_ENTER(ENCRYPT);
+  BFPublicParameters *params = scratch->params;
   message->length = len;
 
   // Step 1
@@ -123,7 +232,7 @@ BFMessage *bf_encrypt(BFPublicParameters *params, element_t public_key,
   // Step 3
   uint8_t rho[hlen];
   if (!RAND_bytes(rho, hlen)) {
-    return NULL;
+    return false;
   }
 
   // Step 4
@@ -131,64 +240,202 @@ BFMessage *bf_encrypt(BFPublicParameters *params, element_t public_key,
   hashfcn(m, len, t);
 
   // Step 5
-  mpz_t l;
-  mpz_init(l);
   uint8_t rho_t[2 * hlen];
   memcpy(rho_t, rho, hlen);
   memcpy(rho_t + hlen, t, hlen);
-  hash_to_range(l, params, rho_t, hlen + hlen, params->q);
+  hash_to_range(scratch->l, params, rho_t, hlen + hlen, params->q);
 
-  // Step 6
+  // Step 6, using the fixed-base table for P.
   element_init_same_as(message->U, params->P);
-  element_mul_mpz(message->U, params->P, l);
+  element_pp_pow(message->U, scratch->l, params->P_precomp);
 
-  // Steps 7/8
-  element_t theta;
-  element_init_GT(theta, params->pairing);
-  pairing_pp_apply(theta, public_key, params->P_pub_precomp);
-  element_pow_mpz(theta, theta, l);
+  // Steps 7/8; the pairing itself already happened (or was cached).
+  BF_STATS_ENTER(GT_POW);
+  element_pow_mpz(scratch->theta, scratch->theta, scratch->l);
+  BF_STATS_LEAVE(GT_POW);
 
   // Step 9
-  size_t zlen = element_length_in_bytes(theta);
+  size_t zlen = element_length_in_bytes(scratch->theta);
   uint8_t z[zlen];
-  element_to_bytes(z, theta);
+  element_to_bytes(z, scratch->theta);
 
-  // Steps 10-11
-  message->V = calloc(hlen, sizeof(uint8_t));
+  // Steps 10-11. Both buffers are fully overwritten, so arena memory
+  // needs no zeroing.
+  message->V = scratch->arena ? bf_arena_alloc(scratch->arena, hlen)
+                              : calloc(hlen, sizeof(uint8_t));
   hashfcn(z, zlen, message->V);
-  for (size_t i = 0; i < hlen; i++) {
-    message->V[i] = message->V[i] ^ rho[i];
-  }
+  xor_bytes(message->V, rho, hlen);
 
   // Step 12
-  message->W = calloc(len, sizeof(uint8_t));
-  hash_to_bytes(message->W, params, len, rho, hlen);
-  for (size_t i = 0; i < len; i++) {
-    message->W[i] = message->W[i] ^ m[i];
+  message->ctr_mode = params->ctr_keystream;
+  message->W = scratch->arena ? bf_arena_alloc(scratch->arena, len)
+                              : calloc(len, sizeof(uint8_t));
+  if (message->ctr_mode) {
+    hash_to_bytes_ctr(message->W, params, len, rho, hlen);
+  } else {
+    hash_to_bytes(message->W, params, len, rho, hlen);
+  }
+  xor_bytes(message->W, m, len);
+
+  BF_STATS_LEAVE(ENCRYPT);
+  return true;
+}
+
+bool bf_encrypt_to(BFMessage *message, BFEncryptScratch *scratch,
+                   element_t public_key, uint8_t *m, size_t len) {
+  BF_STATS_ENTER(PAIRING);
+  pairing_pp_apply(scratch->theta, public_key,
+                   scratch->params->P_pub_precomp);
+  BF_STATS_LEAVE(PAIRING);
+  return encrypt_with_theta_base(message, scratch, m, len);
+}
+
+bool bf_encrypt_to_address(BFMessage *message, BFEncryptScratch *scratch,
+                           char *address, uint8_t *m, size_t len) {
+  BFPublicParameters *params = scratch->params;
+
+  // With a cache attached, steady-state encryption to a known address
+  // skips both hash_to_point and the pairing: only the GT
+  // exponentiation remains per message.
+  if (params->key_cache) {
+    element_set(scratch->theta,
+                bf_key_cache_get_pairing(params->key_cache, address));
+    return encrypt_with_theta_base(message, scratch, m, len);
+  }
+
+  bf_generate_public_key(scratch->public_key, params, address);
+  return bf_encrypt_to(message, scratch, scratch->public_key, m, len);
+}
+
+BFMessage **bf_encrypt_multi(BFPublicParameters *params,
+                             element_t *public_keys, size_t count, uint8_t *m,
+                             size_t len) {
+  size_t hlen = params->security.hashlen;
+  HashFn hashfcn = params->security.hashfcn;
+
+  // Steps 3-5, shared by all recipients.
+  uint8_t rho[hlen];
+  if (!RAND_bytes(rho, hlen)) {
+    return NULL;
+  }
+
+  uint8_t t[hlen];
+  hashfcn(m, len, t);
+
+  mpz_t l;
+  mpz_init(l);
+  uint8_t rho_t[2 * hlen];
+  memcpy(rho_t, rho, hlen);
+  memcpy(rho_t + hlen, t, hlen);
+  hash_to_range(l, params, rho_t, hlen + hlen, params->q);
+
+  // Step 6, shared. One fixed-base multiplication for the whole fan-out.
+  element_t U;
+  element_init_same_as(U, params->P);
+  element_pp_pow(U, l, params->P_precomp);
+
+  // Step 12's mask is independent of the recipient; compute W once.
+  uint8_t *W = malloc(len);
+  if (params->ctr_keystream) {
+    hash_to_bytes_ctr(W, params, len, rho, hlen);
+  } else {
+    hash_to_bytes(W, params, len, rho, hlen);
+  }
+  xor_bytes(W, m, len);
+
+  element_t theta;
+  element_init_GT(theta, params->pairing);
+
+  BFMessage **messages = calloc(count, sizeof(*messages));
+  for (size_t r = 0; r < count; r++) {
+    BFMessage *message = calloc(1, sizeof(*message));
+    message->length = len;
+    message->ctr_mode = params->ctr_keystream;
+
+    element_init_same_as(message->U, params->P);
+    element_set(message->U, U);
+
+    // Steps 7/8, the only per-recipient group operations.
+    pairing_pp_apply(theta, public_keys[r], params->P_pub_precomp);
+    element_pow_mpz(theta, theta, l);
+
+    // Step 9
+    size_t zlen = element_length_in_bytes(theta);
+    uint8_t z[zlen];
+    element_to_bytes(z, theta);
+
+    // Steps 10-11
+    message->V = calloc(hlen, sizeof(uint8_t));
+    hashfcn(z, zlen, message->V);
+    xor_bytes(message->V, rho, hlen);
+
+    message->W = malloc(len);
+    memcpy(message->W, W, len);
+
+    messages[r] = message;
   }
 
   element_clear(theta);
+  element_clear(U);
   mpz_clear(l);
+  free(W);
 
-  return message;
+  return messages;
+}
+
+/*
+ * Initialize a decryption context from a private key, preprocessing the
+ * pairing on the key. The pairing is symmetric for our curves, so
+ * e(U, key) can be computed as e(key, U) with the key side fixed.
+ */
+void bf_decryption_context_init(BFDecryptionContext *context,
+                                BFPublicParameters *params,
+                                element_t private_key) {
+  context->params = params;
+  pairing_pp_init(context->key_precomp, private_key, params->pairing);
+  element_init_GT(context->theta, params->pairing);
+  element_init_G1(context->lP, params->pairing);
+  mpz_init(context->l);
+}
+
+void bf_decryption_context_clear(BFDecryptionContext *context) {
+  pairing_pp_clear(context->key_precomp);
+  element_clear(context->theta);
+  element_clear(context->lP);
+  mpz_clear(context->l);
+  context->params = NULL;
 }
 
 bool bf_decrypt(uint8_t *output, BFPublicParameters *params,
                 element_t private_key, BFMessage *message) {
+  BFDecryptionContext context;
+  bf_decryption_context_init(&context, params, private_key);
+  bool retval = bf_decrypt_with_context(output, &context, message);
+  bf_decryption_context_clear(&context);
+  return retval;
+}
+
+/*
+ * Steps 1-8 of decryption, shared by the verified and unverified entry
+ * points. Leaves the derived exponent l in context->l.
+ */
+static void decrypt_core(uint8_t *output, BFDecryptionContext *context,
+                         BFMessage *message) {
+  BFPublicParameters *params = context->params;
+
   // Step 1
   size_t hlen = params->security.hashlen;
   HashFn hashfcn = params->security.hashfcn;
-  bool retval = true;
 
   // Step 2
-  element_t theta;
-  element_init_GT(theta, params->pairing);
-  element_pairing(theta, message->U, private_key);
+  BF_STATS_ENTER(PAIRING);
+  pairing_pp_apply(context->theta, message->U, context->key_precomp);
+  BF_STATS_LEAVE(PAIRING);
 
   // Step 3
-  size_t zlen = element_length_in_bytes(theta);
+  size_t zlen = element_length_in_bytes(context->theta);
   uint8_t z[zlen];
-  element_to_bytes(z, theta);
+  element_to_bytes(z, context->theta);
 
   // Step 4
   uint8_t w[hlen];
@@ -196,15 +443,15 @@ bool bf_decrypt(uint8_t *output, BFPublicParameters *params,
 
   // Step 5
   // w becomes rho
-  for (size_t i = 0; i < hlen; i++) {
-    w[i] = w[i] ^ message->V[i];
-  }
+  xor_bytes(w, message->V, hlen);
 
-  // Step 6
-  hash_to_bytes(output, params, message->length, w, hlen);
-  for (size_t i = 0; i < message->length; i++) {
-    output[i] = output[i] ^ message->W[i];
+  // Step 6. Follow the keystream mode the ciphertext was created with.
+  if (message->ctr_mode) {
+    hash_to_bytes_ctr(output, params, message->length, w, hlen);
+  } else {
+    hash_to_bytes(output, params, message->length, w, hlen);
   }
+  xor_bytes(output, message->W, message->length);
 
   // Step 7
   uint8_t t[hlen];
@@ -215,28 +462,75 @@ bool bf_decrypt(uint8_t *output, BFPublicParameters *params,
   memcpy(rho_t, w, hlen);
   memcpy(rho_t + hlen, t, hlen);
 
-  mpz_t l;
-  mpz_init(l);
-  hash_to_range(l, params, rho_t, hlen * 2, params->q);
+  hash_to_range(context->l, params, rho_t, hlen * 2, params->q);
+}
 
-  // Step 9. Verify correctness.
-  element_t lP;
-  element_init_G1(lP, params->pairing);
-  element_mul_mpz(lP, params->P, l);
+bool bf_decrypt_with_context(uint8_t *output, BFDecryptionContext *context,
+                             BFMessage *message) {
+  bool retval = true;
+  BF_STATS_ENTER(DECRYPT);
+  decrypt_core(output, context, message);
 
-  // Check that U = l[P]
-  if (element_cmp(message->U, lP)) {
+  // Step 9. Verify correctness, using the fixed-base table for P.
+  if (!bf_verify(context, message)) {
     // Check failed
     retval = false;
     memset(output, 0, message->length);
   }
 
-  element_clear(theta);
-  element_clear(lP);
-  mpz_clear(l);
+  BF_STATS_LEAVE(DECRYPT);
   return retval;
 }
 
+bool bf_decrypt_with_context_unverified(uint8_t *output,
+                                        BFDecryptionContext *context,
+                                        BFMessage *message) {
+  BF_STATS_ENTER(DECRYPT);
+  decrypt_core(output, context, message);
+  BF_STATS_LEAVE(DECRYPT);
+  return true;
+}
+
+bool bf_decrypt_unverified(uint8_t *output, BFPublicParameters *params,
+                           element_t private_key, BFMessage *message) {
+  BFDecryptionContext context;
+  bf_decryption_context_init(&context, params, private_key);
+  bool retval = bf_decrypt_with_context_unverified(output, &context, message);
+  bf_decryption_context_clear(&context);
+  return retval;
+}
+
+bool bf_verify(BFDecryptionContext *context, BFMessage *message) {
+  // Check that U = [l]P, using the fixed-base table for P.
+  element_pp_pow(context->lP, context->l, context->params->P_precomp);
+  return element_cmp(message->U, context->lP) == 0;
+}
+
+bool bf_params_clone(BFPublicParameters *dst, BFPublicParameters *src) {
+  dst->security = src->security;
+  dst->key_cache = NULL;
+  dst->ctr_keystream = src->ctr_keystream;
+
+  // Shards share the refcounted curve/pairing core; only the public
+  // point and its preprocessing are duplicated.
+  bf_params_attach_core(dst, bf_pairing_core_ref(src->core));
+
+  element_init_same_as(dst->P_pub, dst->P);
+  element_set(dst->P_pub, src->P_pub);
+  pairing_pp_init(dst->P_pub_precomp, dst->P_pub, dst->pairing);
+
+  return true;
+}
+
+void bf_params_clear(BFPublicParameters *params) {
+  bf_key_cache_free(params->key_cache);
+  params->key_cache = NULL;
+  pairing_pp_clear(params->P_pub_precomp);
+  element_clear(params->P_pub);
+  bf_pairing_core_unref(params->core);
+  params->core = NULL;
+}
+
 /* Frees the memory allocated for a message. */
 void bf_message_free(BFMessage *msg) {
   free(msg->V);
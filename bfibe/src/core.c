@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include "bfibe.h"
+#include "core.h"
+
+BFPairingCore *bf_pairing_core_new(void) {
+  BFPairingCore *core = calloc(1, sizeof(*core));
+  atomic_init(&core->refcount, 1);
+  return core;
+}
+
+BFPairingCore *bf_pairing_core_ref(BFPairingCore *core) {
+  atomic_fetch_add_explicit(&core->refcount, 1, memory_order_relaxed);
+  return core;
+}
+
+void bf_pairing_core_unref(BFPairingCore *core) {
+  if (!core) {
+    return;
+  }
+  if (atomic_fetch_sub_explicit(&core->refcount, 1, memory_order_acq_rel) !=
+      1) {
+    return;
+  }
+
+  element_pp_clear(core->P_precomp);
+  element_clear(core->P);
+  mpz_clear(core->q);
+  pairing_clear(core->pairing);
+  pbc_param_clear(core->pbc_par);
+  free(core);
+}
+
+void bf_params_attach_core(BFPublicParameters *params, BFPairingCore *core) {
+  params->core = core;
+  params->pbc_par = core->pbc_par;
+  params->pairing = core->pairing;
+  params->P = core->P;
+  params->P_precomp = core->P_precomp;
+  params->q = core->q;
+}
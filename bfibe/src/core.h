@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#pragma once
+#include <stdatomic.h>
+
+/*
+ * The immutable curve/pairing core shared by every shard of one
+ * system. Shard copies used to duplicate the whole pairing and its
+ * precomputation tables even though shards differ only in P_pub; on a
+ * committee node holding a dozen shards those redundant structures
+ * dominated resident memory. The core is created once per distinct
+ * curve and refcounted; BFPublicParameters holds borrowed pointers
+ * into it plus its own per-shard state.
+ *
+ * Sharing a pairing also shares PBC's internal scratch state, so
+ * shards over one core must not be used from multiple threads at
+ * once. The parallel engines keep a core per worker for this reason.
+ */
+typedef struct BFPairingCore {
+  _Atomic int refcount;
+
+  pbc_param_t pbc_par;
+  pairing_t pairing;
+
+  // The system generator and its fixed-base window table.
+  element_t P;
+  element_pp_t P_precomp;
+
+  // The order of the cyclic subgroup of G1.
+  mpz_t q;
+} BFPairingCore;
+
+/*
+ * Allocates a zeroed core holding one reference; the caller
+ * initializes the PBC state before attaching it.
+ */
+BFPairingCore *bf_pairing_core_new(void);
+
+BFPairingCore *bf_pairing_core_ref(BFPairingCore *core);
+
+/*
+ * Drops a reference, destroying the curve and pairing state with the
+ * last one. Elements initialized against the pairing must already be
+ * cleared by then.
+ */
+void bf_pairing_core_unref(BFPairingCore *core);
+
+/*
+ * Points params at core, wiring up the aliased convenience pointers.
+ * Takes over the caller's reference.
+ */
+void bf_params_attach_core(BFPublicParameters *params, BFPairingCore *core);
@@ -0,0 +1,663 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include "api.h"
+#include "bfibe.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/*
+ * A worker-pool engine for parallel IBE operations.
+ *
+ * PBC's pairing_t and element operations are not safe for concurrent
+ * use, so each worker thread owns a full clone of the pairing and curve
+ * state, derived from the base system by a serialize/parse round-trip
+ * at engine creation time. Batches are distributed by handing out item
+ * indices under a single lock; the group operations dominate by orders
+ * of magnitude, so contention on the index counter is negligible.
+ */
+
+typedef enum {
+  BATCH_IDLE,
+  BATCH_ENCRYPT,
+  BATCH_DECRYPT,
+  BATCH_KEYGEN,
+  BATCH_SHUTDOWN,
+} BatchKind;
+
+typedef struct {
+  BatchKind kind;
+  int count;
+  int next;
+  int completed;
+
+  // Set when an encrypt item fails; no further indices are handed out,
+  // matching encrypt_ibe_batch's fail-fast convention. failed counts
+  // the claimed items that produced no output.
+  bool stopped;
+  int failed;
+
+  char **addresses;
+  void **inputs;
+  int *input_lengths;
+  void **outputs;
+  int *output_lengths;
+  char **key_outputs;
+
+  // Serialized private key (decrypt) or system secret (keygen). Each
+  // worker parses its own copy against its own pairing, since elements
+  // cannot cross pairing instances.
+  const char *key_string;
+  const char *secret_string;
+} BatchState;
+
+struct BFEngine;
+
+typedef struct {
+  struct BFEngine *engine;
+  BFPublicParameters *params;
+  BFEncryptScratch scratch;
+} BFWorker;
+
+typedef struct BFEngine {
+  int thread_count;
+  pthread_t *threads;
+  BFWorker *workers;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;
+  pthread_cond_t batch_done;
+
+  // Bumped for every new batch so sleeping workers can tell a fresh
+  // batch from a spurious wakeup.
+  int generation;
+  BatchState batch;
+} BFEngine;
+
+static void engine_encrypt_item(BFWorker *self, BatchState *batch, int index) {
+  BFMessage ciphertext;
+  if (!bf_encrypt_to_address(&ciphertext, &self->scratch,
+                             batch->addresses[index],
+                             (uint8_t *)batch->inputs[index],
+                             batch->input_lengths[index])) {
+    batch->outputs[index] = NULL;
+    batch->output_lengths[index] = 0;
+    return;
+  }
+
+  uint8_t *cipher_bytes;
+  batch->output_lengths[index] =
+      bf_message_to_bytes(&cipher_bytes, self->params, &ciphertext);
+  batch->outputs[index] = cipher_bytes;
+
+  free(ciphertext.V);
+  free(ciphertext.W);
+  element_clear(ciphertext.U);
+}
+
+static void engine_decrypt_item(BFWorker *self, BFDecryptionContext *context,
+                                BatchState *batch, int index) {
+  int out_length = 0;
+  batch->outputs[index] = decrypt_ibe_with_context(
+      context, batch->inputs[index], batch->input_lengths[index], &out_length);
+  batch->output_lengths[index] = out_length;
+}
+
+static void *worker_main(void *arg) {
+  BFWorker *self = arg;
+  BFEngine *engine = self->engine;
+  int seen_generation = 0;
+
+  pthread_mutex_lock(&engine->lock);
+  for (;;) {
+    while (engine->generation == seen_generation) {
+      pthread_cond_wait(&engine->work_ready, &engine->lock);
+    }
+    seen_generation = engine->generation;
+
+    BatchState *batch = &engine->batch;
+    BatchKind kind = batch->kind;
+    if (kind == BATCH_SHUTDOWN) {
+      break;
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    // Per-batch setup: materialize keys against this worker's pairing.
+    element_t *private_key = NULL;
+    void *secret = NULL;
+    BFDecryptionContext context;
+    if (kind == BATCH_DECRYPT) {
+      private_key = parse_private_key(self->params, batch->key_string);
+      bf_decryption_context_init(&context, self->params, *private_key);
+    } else if (kind == BATCH_KEYGEN) {
+      secret = parse_system_secret(batch->secret_string);
+    }
+
+    for (;;) {
+      pthread_mutex_lock(&engine->lock);
+      if (engine->generation != seen_generation) {
+        // engine_run returned once the last item completed, and a new
+        // batch landed before this worker's next claim. Bail out so the
+        // wakeup path at the top picks up the new batch's kind and key.
+        pthread_mutex_unlock(&engine->lock);
+        break;
+      }
+      int index = batch->next;
+      if (batch->stopped || index >= batch->count) {
+        pthread_mutex_unlock(&engine->lock);
+        break;
+      }
+      batch->next++;
+      pthread_mutex_unlock(&engine->lock);
+
+      bool ok = true;
+      switch (kind) {
+      case BATCH_ENCRYPT:
+        engine_encrypt_item(self, batch, index);
+        ok = batch->outputs[index] != NULL;
+        break;
+      case BATCH_DECRYPT:
+        engine_decrypt_item(self, &context, batch, index);
+        ok = batch->outputs[index] != NULL;
+        break;
+      case BATCH_KEYGEN:
+        batch->key_outputs[index] = generate_private_key(
+            self->params, secret, batch->addresses[index]);
+        break;
+      default:
+        break;
+      }
+
+      pthread_mutex_lock(&engine->lock);
+      if (!ok) {
+        batch->failed++;
+        // Only encryption is fail-fast; decrypt batches tolerate bad
+        // entries, so their failures just don't count as successes.
+        if (kind == BATCH_ENCRYPT) {
+          batch->stopped = true;
+        }
+      }
+      batch->completed++;
+      if (batch->completed == batch->count ||
+          (batch->stopped && batch->completed == batch->next)) {
+        pthread_cond_signal(&engine->batch_done);
+      }
+      pthread_mutex_unlock(&engine->lock);
+    }
+
+    if (kind == BATCH_DECRYPT) {
+      bf_decryption_context_clear(&context);
+      element_clear(*private_key);
+      free(private_key);
+    } else if (kind == BATCH_KEYGEN) {
+      mpz_clear(*(mpz_t *)secret);
+      free(secret);
+    }
+
+    pthread_mutex_lock(&engine->lock);
+  }
+  pthread_mutex_unlock(&engine->lock);
+  return NULL;
+}
+
+/*
+ * Hand a batch to the workers and wait for every item to complete.
+ * Returns the number of items processed.
+ */
+static int engine_run(BFEngine *engine, BatchState *batch) {
+  if (batch->count <= 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&engine->lock);
+  engine->batch = *batch;
+  engine->batch.next = 0;
+  engine->batch.completed = 0;
+  engine->batch.stopped = false;
+  engine->batch.failed = 0;
+  engine->generation++;
+  pthread_cond_broadcast(&engine->work_ready);
+
+  // Wait for every item, or on an early stop for the claimed items
+  // still in flight.
+  while (engine->batch.completed < engine->batch.count &&
+         !(engine->batch.stopped &&
+           engine->batch.completed == engine->batch.next)) {
+    pthread_cond_wait(&engine->batch_done, &engine->lock);
+  }
+
+  // On early stop, clear the never-attempted slots so the caller can't
+  // read stale pointers past the reported count.
+  if (engine->batch.stopped) {
+    for (int i = engine->batch.next; i < engine->batch.count; i++) {
+      engine->batch.outputs[i] = NULL;
+      engine->batch.output_lengths[i] = 0;
+    }
+  }
+
+  int done = engine->batch.completed - engine->batch.failed;
+  engine->batch.kind = BATCH_IDLE;
+  pthread_mutex_unlock(&engine->lock);
+  return done;
+}
+
+void *create_parallel_engine(void *system, int thread_count) {
+  if (thread_count <= 0) {
+    thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+
+  BFEngine *engine = calloc(1, sizeof(*engine));
+  engine->thread_count = thread_count;
+  engine->threads = calloc(thread_count, sizeof(*engine->threads));
+  engine->workers = calloc(thread_count, sizeof(*engine->workers));
+  pthread_mutex_init(&engine->lock, NULL);
+  pthread_cond_init(&engine->work_ready, NULL);
+  pthread_cond_init(&engine->batch_done, NULL);
+  engine->batch.kind = BATCH_IDLE;
+
+  char *param_str = format_system_params(system);
+  for (int i = 0; i < thread_count; i++) {
+    BFWorker *worker = &engine->workers[i];
+    worker->engine = engine;
+    worker->params = parse_system_params(param_str);
+    // The text form doesn't carry the keystream mode; mirror it so
+    // workers emit the same format version as the base system.
+    worker->params->ctr_keystream =
+        ((BFPublicParameters *)system)->ctr_keystream;
+    bf_encrypt_scratch_init(&worker->scratch, worker->params);
+    pthread_create(&engine->threads[i], NULL, worker_main, worker);
+  }
+  free(param_str);
+
+  return engine;
+}
+
+void destroy_parallel_engine(void *handle) {
+  BFEngine *engine = (BFEngine *)handle;
+  if (!engine) {
+    return;
+  }
+
+  pthread_mutex_lock(&engine->lock);
+  engine->batch.kind = BATCH_SHUTDOWN;
+  engine->generation++;
+  pthread_cond_broadcast(&engine->work_ready);
+  pthread_mutex_unlock(&engine->lock);
+
+  for (int i = 0; i < engine->thread_count; i++) {
+    pthread_join(engine->threads[i], NULL);
+  }
+
+  for (int i = 0; i < engine->thread_count; i++) {
+    BFWorker *worker = &engine->workers[i];
+    bf_encrypt_scratch_clear(&worker->scratch);
+    bf_params_clear(worker->params);
+    free(worker->params);
+  }
+
+  pthread_mutex_destroy(&engine->lock);
+  pthread_cond_destroy(&engine->work_ready);
+  pthread_cond_destroy(&engine->batch_done);
+  free(engine->threads);
+  free(engine->workers);
+  free(engine);
+}
+
+int parallel_encrypt(void *engine, char **addresses, void **messages, int *message_lengths,
+                     int message_count, void **ciphertexts_out, int *lengths_out) {
+  BatchState batch = {0};
+  batch.kind = BATCH_ENCRYPT;
+  batch.count = message_count;
+  batch.addresses = addresses;
+  batch.inputs = messages;
+  batch.input_lengths = message_lengths;
+  batch.outputs = ciphertexts_out;
+  batch.output_lengths = lengths_out;
+  return engine_run((BFEngine *)engine, &batch);
+}
+
+int parallel_decrypt(void *engine, char *private_key, void **ciphertexts, int *ciphertext_lengths,
+                     int ciphertext_count, void **plaintexts_out, int *lengths_out) {
+  BatchState batch = {0};
+  batch.kind = BATCH_DECRYPT;
+  batch.count = ciphertext_count;
+  batch.inputs = ciphertexts;
+  batch.input_lengths = ciphertext_lengths;
+  batch.outputs = plaintexts_out;
+  batch.output_lengths = lengths_out;
+  batch.key_string = private_key;
+  return engine_run((BFEngine *)engine, &batch);
+}
+
+int parallel_generate_private_keys(void *engine, char *secret, char **addresses,
+                                   int address_count, char **keys_out) {
+  BatchState batch = {0};
+  batch.kind = BATCH_KEYGEN;
+  batch.count = address_count;
+  batch.addresses = addresses;
+  batch.key_outputs = keys_out;
+  batch.secret_string = secret;
+  return engine_run((BFEngine *)engine, &batch);
+}
+
+/*
+ * The asynchronous service. Unlike the batch engine above, which
+ * blocks the caller until a whole batch drains, submissions return a
+ * ticket immediately and finished operations accumulate on a
+ * completion queue the caller drains with poll_completions. An eventfd
+ * becomes readable whenever completions are pending, so an async
+ * runtime can wait on it instead of polling. Inputs are copied at
+ * submission; outputs stay owned by the queue until polled.
+ */
+
+typedef struct BFAsyncOp {
+  unsigned long long ticket;
+  BatchKind kind;
+
+  char *address;    // encrypt: owned copy of the destination
+  char *key_string; // decrypt: owned copy of the serialized key
+  uint8_t *input;   // owned copy of the message or ciphertext
+  int input_length;
+
+  void *output;
+  int output_length;
+
+  struct BFAsyncOp *next;
+} BFAsyncOp;
+
+struct BFAsyncEngine;
+
+typedef struct {
+  struct BFAsyncEngine *engine;
+  BFPublicParameters *params;
+  BFEncryptScratch scratch;
+
+  // Decrypt state, rebuilt only when the submitted key changes. A
+  // worker draining a dropbox session sees the same key for every
+  // ciphertext, so the parse and pairing preprocessing amortize away.
+  char *current_key;
+  element_t *private_key;
+  BFDecryptionContext context;
+} BFAsyncWorker;
+
+typedef struct BFAsyncEngine {
+  int thread_count;
+  pthread_t *threads;
+  BFAsyncWorker *workers;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;
+  bool shutdown;
+
+  unsigned long long next_ticket;
+  BFAsyncOp *pending_head;
+  BFAsyncOp *pending_tail;
+  BFAsyncOp *done_head;
+  BFAsyncOp *done_tail;
+
+  int event_fd;
+} BFAsyncEngine;
+
+static void async_op_free(BFAsyncOp *op) {
+  free(op->address);
+  free(op->key_string);
+  free(op->input);
+  free(op);
+}
+
+static void async_worker_drop_key(BFAsyncWorker *self) {
+  if (!self->current_key) {
+    return;
+  }
+  bf_decryption_context_clear(&self->context);
+  element_clear(*self->private_key);
+  free(self->private_key);
+  free(self->current_key);
+  self->current_key = NULL;
+}
+
+static void async_process(BFAsyncWorker *self, BFAsyncOp *op) {
+  op->output = NULL;
+  op->output_length = 0;
+
+  if (op->kind == BATCH_ENCRYPT) {
+    BFMessage ciphertext;
+    if (!bf_encrypt_to_address(&ciphertext, &self->scratch, op->address,
+                               op->input, op->input_length)) {
+      return;
+    }
+
+    uint8_t *cipher_bytes;
+    op->output_length =
+        bf_message_to_bytes(&cipher_bytes, self->params, &ciphertext);
+    op->output = cipher_bytes;
+
+    free(ciphertext.V);
+    free(ciphertext.W);
+    element_clear(ciphertext.U);
+    return;
+  }
+
+  // Decrypt: materialize the key against this worker's pairing if it
+  // differs from the last one seen.
+  if (!self->current_key || strcmp(self->current_key, op->key_string)) {
+    async_worker_drop_key(self);
+    self->private_key = parse_private_key(self->params, op->key_string);
+    bf_decryption_context_init(&self->context, self->params,
+                               *self->private_key);
+    self->current_key = strdup(op->key_string);
+  }
+
+  BFMessage msg;
+  if (!bf_message_from_bytes_view(op->input, op->input_length, self->params,
+                                  &msg)) {
+    return;
+  }
+
+  uint8_t *output = malloc(msg.length > 0 ? msg.length : 1);
+  if (bf_decrypt_with_context(output, &self->context, &msg)) {
+    op->output = output;
+    op->output_length = msg.length;
+  } else {
+    free(output);
+  }
+  element_clear(msg.U);
+}
+
+static void *async_worker_main(void *arg) {
+  BFAsyncWorker *self = arg;
+  BFAsyncEngine *engine = self->engine;
+
+  pthread_mutex_lock(&engine->lock);
+  for (;;) {
+    while (!engine->pending_head && !engine->shutdown) {
+      pthread_cond_wait(&engine->work_ready, &engine->lock);
+    }
+    if (engine->shutdown) {
+      break;
+    }
+
+    BFAsyncOp *op = engine->pending_head;
+    engine->pending_head = op->next;
+    if (!engine->pending_head) {
+      engine->pending_tail = NULL;
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    async_process(self, op);
+    op->next = NULL;
+
+    pthread_mutex_lock(&engine->lock);
+    if (engine->done_tail) {
+      engine->done_tail->next = op;
+    } else {
+      engine->done_head = op;
+    }
+    engine->done_tail = op;
+
+    if (engine->event_fd >= 0) {
+      uint64_t one = 1;
+      ssize_t ignored = write(engine->event_fd, &one, sizeof(one));
+      (void)ignored;
+    }
+  }
+  pthread_mutex_unlock(&engine->lock);
+  return NULL;
+}
+
+void *create_async_engine(void *system, int thread_count) {
+  if (thread_count <= 0) {
+    thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+
+  BFAsyncEngine *engine = calloc(1, sizeof(*engine));
+  engine->thread_count = thread_count;
+  engine->threads = calloc(thread_count, sizeof(*engine->threads));
+  engine->workers = calloc(thread_count, sizeof(*engine->workers));
+  pthread_mutex_init(&engine->lock, NULL);
+  pthread_cond_init(&engine->work_ready, NULL);
+  engine->next_ticket = 1;
+  engine->event_fd = eventfd(0, EFD_NONBLOCK);
+
+  char *param_str = format_system_params(system);
+  for (int i = 0; i < thread_count; i++) {
+    BFAsyncWorker *worker = &engine->workers[i];
+    worker->engine = engine;
+    worker->params = parse_system_params(param_str);
+    worker->params->ctr_keystream =
+        ((BFPublicParameters *)system)->ctr_keystream;
+    bf_encrypt_scratch_init(&worker->scratch, worker->params);
+    pthread_create(&engine->threads[i], NULL, async_worker_main, worker);
+  }
+  free(param_str);
+
+  return engine;
+}
+
+void destroy_async_engine(void *handle) {
+  BFAsyncEngine *engine = (BFAsyncEngine *)handle;
+  if (!engine) {
+    return;
+  }
+
+  pthread_mutex_lock(&engine->lock);
+  engine->shutdown = true;
+  pthread_cond_broadcast(&engine->work_ready);
+  pthread_mutex_unlock(&engine->lock);
+
+  for (int i = 0; i < engine->thread_count; i++) {
+    pthread_join(engine->threads[i], NULL);
+  }
+
+  for (BFAsyncOp *op = engine->pending_head; op;) {
+    BFAsyncOp *next = op->next;
+    async_op_free(op);
+    op = next;
+  }
+  for (BFAsyncOp *op = engine->done_head; op;) {
+    BFAsyncOp *next = op->next;
+    free(op->output);
+    async_op_free(op);
+    op = next;
+  }
+
+  for (int i = 0; i < engine->thread_count; i++) {
+    BFAsyncWorker *worker = &engine->workers[i];
+    async_worker_drop_key(worker);
+    bf_encrypt_scratch_clear(&worker->scratch);
+    bf_params_clear(worker->params);
+    free(worker->params);
+  }
+
+  if (engine->event_fd >= 0) {
+    close(engine->event_fd);
+  }
+  pthread_mutex_destroy(&engine->lock);
+  pthread_cond_destroy(&engine->work_ready);
+  free(engine->threads);
+  free(engine->workers);
+  free(engine);
+}
+
+int async_engine_fd(void *handle) {
+  return ((BFAsyncEngine *)handle)->event_fd;
+}
+
+static unsigned long long async_submit(BFAsyncEngine *engine, BFAsyncOp *op) {
+  pthread_mutex_lock(&engine->lock);
+  op->ticket = engine->next_ticket++;
+  if (engine->pending_tail) {
+    engine->pending_tail->next = op;
+  } else {
+    engine->pending_head = op;
+  }
+  engine->pending_tail = op;
+  pthread_cond_signal(&engine->work_ready);
+  pthread_mutex_unlock(&engine->lock);
+  return op->ticket;
+}
+
+unsigned long long submit_encrypt(void *handle, char *address, void *message,
+                                  int message_len) {
+  BFAsyncOp *op = calloc(1, sizeof(*op));
+  op->kind = BATCH_ENCRYPT;
+  op->address = strdup(address);
+  op->input = malloc(message_len > 0 ? message_len : 1);
+  memcpy(op->input, message, message_len);
+  op->input_length = message_len;
+  return async_submit((BFAsyncEngine *)handle, op);
+}
+
+unsigned long long submit_decrypt(void *handle, char *private_key,
+                                  void *ciphertext, int ciphertext_len) {
+  BFAsyncOp *op = calloc(1, sizeof(*op));
+  op->kind = BATCH_DECRYPT;
+  op->key_string = strdup(private_key);
+  op->input = malloc(ciphertext_len > 0 ? ciphertext_len : 1);
+  memcpy(op->input, ciphertext, ciphertext_len);
+  op->input_length = ciphertext_len;
+  return async_submit((BFAsyncEngine *)handle, op);
+}
+
+int poll_completions(void *handle, unsigned long long *tickets,
+                     void **outputs, int *output_lengths, int max) {
+  BFAsyncEngine *engine = (BFAsyncEngine *)handle;
+  int drained = 0;
+
+  pthread_mutex_lock(&engine->lock);
+  while (drained < max && engine->done_head) {
+    BFAsyncOp *op = engine->done_head;
+    engine->done_head = op->next;
+    if (!engine->done_head) {
+      engine->done_tail = NULL;
+    }
+
+    tickets[drained] = op->ticket;
+    outputs[drained] = op->output;
+    output_lengths[drained] = op->output_length;
+    drained++;
+    async_op_free(op);
+  }
+
+  // Clear the eventfd once the queue is empty so the event loop does
+  // not spin on a stale readiness signal.
+  if (!engine->done_head && engine->event_fd >= 0) {
+    uint64_t count;
+    ssize_t ignored = read(engine->event_fd, &count, sizeof(count));
+    (void)ignored;
+  }
+  pthread_mutex_unlock(&engine->lock);
+
+  return drained;
+}
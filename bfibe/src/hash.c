@@ -4,6 +4,7 @@
  */
 
 #include "bfibe.h"
+#include "stats.h"
 #include <openssl/sha.h>
 #include <string.h>
 
@@ -13,11 +14,13 @@
  */
 void hash_to_point(element_t Q, BFPublicParameters *params, void *input,
                    size_t len) {
+  BF_STATS_ENTER(HASH_TO_POINT);
   uint8_t *bytes = input;
   size_t hlen = params->security.hashlen;
   uint8_t md[hlen];
   params->security.hashfcn(bytes, len, md);
   element_from_hash(Q, md, hlen);
+  BF_STATS_LEAVE(HASH_TO_POINT);
 }
 
 /*
@@ -54,6 +57,41 @@ void hash_to_range(mpz_t result, BFPublicParameters *params, void *input,
   mpz_clears(v, vmul, a, NULL);
 }
 
+/*
+ * Counter-mode variant of HashBytes: each keystream block is
+ * hashfcn(K || counter) instead of being chained through the previous
+ * block, so blocks are independent and can be computed out of order or
+ * fanned out across multi-buffer SHA implementations. Diverges from
+ * RFC 5091, so it's only used for ciphertexts whose format version
+ * says so; see bf_message_to_bytes.
+ */
+void hash_to_bytes_ctr(uint8_t *result, BFPublicParameters *params,
+                       size_t outlen, void *input, size_t len) {
+  uint8_t *seed = input;
+  size_t hlen = params->security.hashlen;
+  HashFn hashfcn = params->security.hashfcn;
+
+  uint8_t block_input[hlen + 4];
+  hashfcn(seed, len, block_input);
+
+  uint8_t r[hlen];
+  size_t copied = 0;
+  uint32_t counter = 0;
+
+  while (copied < outlen) {
+    block_input[hlen] = (counter >> 24) & 0xff;
+    block_input[hlen + 1] = (counter >> 16) & 0xff;
+    block_input[hlen + 2] = (counter >> 8) & 0xff;
+    block_input[hlen + 3] = counter & 0xff;
+    hashfcn(block_input, hlen + 4, r);
+
+    size_t n = outlen - copied < hlen ? outlen - copied : hlen;
+    memcpy(result + copied, r, n);
+    copied += n;
+    counter++;
+  }
+}
+
 /*
  * Implements HashBytes (4.2.1) from RFC 5091.
  * Generates outputlen random bytes based on a seed.
@@ -22,3 +22,11 @@ void hash_to_range(mpz_t result, BFPublicParameters *params, void *input,
  */
 void hash_to_bytes(uint8_t *result, BFPublicParameters *params, size_t outlen,
                    void *input, size_t len);
+
+/*
+ * Counter-mode keystream expansion: blocks are independent hashes of
+ * the seed key and a counter rather than a serial chain. Not
+ * interoperable with hash_to_bytes output.
+ */
+void hash_to_bytes_ctr(uint8_t *result, BFPublicParameters *params,
+                       size_t outlen, void *input, size_t len);
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include "bfibe.h"
+#include "keycache.h"
+#include "hash.h"
+#include "stats.h"
+#include <string.h>
+
+/*
+ * Chained hash table with an intrusive LRU list. The list head is the
+ * most recently used entry; eviction pops the tail.
+ */
+typedef struct BFCacheEntry {
+  char *identity;
+  element_t point;
+
+  // Lazily computed e(Q_id, P_pub), the recipient-dependent pairing
+  // base used by encryption. Only valid while has_pairing is set.
+  element_t pairing_value;
+  bool has_pairing;
+
+  struct BFCacheEntry *hash_next;
+  struct BFCacheEntry *lru_prev;
+  struct BFCacheEntry *lru_next;
+} BFCacheEntry;
+
+struct BFKeyCache {
+  BFPublicParameters *params;
+  size_t capacity;
+  size_t count;
+
+  size_t bucket_count;
+  BFCacheEntry **buckets;
+
+  BFCacheEntry *lru_head;
+  BFCacheEntry *lru_tail;
+};
+
+/* FNV-1a over the identity string. */
+static size_t identity_hash(const char *identity) {
+  size_t h = 14695981039346656037ull;
+  for (const uint8_t *p = (const uint8_t *)identity; *p; p++) {
+    h = (h ^ *p) * 1099511628211ull;
+  }
+  return h;
+}
+
+BFKeyCache *bf_key_cache_new(BFPublicParameters *params, size_t capacity) {
+  if (capacity == 0) {
+    return NULL;
+  }
+
+  BFKeyCache *cache = calloc(1, sizeof(*cache));
+  cache->params = params;
+  cache->capacity = capacity;
+
+  // Size the table to keep chains short at full capacity.
+  cache->bucket_count = 16;
+  while (cache->bucket_count < capacity * 2) {
+    cache->bucket_count <<= 1;
+  }
+  cache->buckets = calloc(cache->bucket_count, sizeof(*cache->buckets));
+
+  return cache;
+}
+
+static void lru_unlink(BFKeyCache *cache, BFCacheEntry *entry) {
+  if (entry->lru_prev) {
+    entry->lru_prev->lru_next = entry->lru_next;
+  } else {
+    cache->lru_head = entry->lru_next;
+  }
+  if (entry->lru_next) {
+    entry->lru_next->lru_prev = entry->lru_prev;
+  } else {
+    cache->lru_tail = entry->lru_prev;
+  }
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(BFKeyCache *cache, BFCacheEntry *entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = cache->lru_head;
+  if (cache->lru_head) {
+    cache->lru_head->lru_prev = entry;
+  }
+  cache->lru_head = entry;
+  if (!cache->lru_tail) {
+    cache->lru_tail = entry;
+  }
+}
+
+static void table_remove(BFKeyCache *cache, BFCacheEntry *entry) {
+  size_t bucket = identity_hash(entry->identity) & (cache->bucket_count - 1);
+  BFCacheEntry **link = &cache->buckets[bucket];
+  while (*link != entry) {
+    link = &(*link)->hash_next;
+  }
+  *link = entry->hash_next;
+  entry->hash_next = NULL;
+}
+
+static void entry_free(BFCacheEntry *entry) {
+  element_clear(entry->point);
+  if (entry->has_pairing) {
+    element_clear(entry->pairing_value);
+  }
+  free(entry->identity);
+  free(entry);
+}
+
+static BFCacheEntry *cache_lookup(BFKeyCache *cache, const char *identity) {
+  size_t bucket = identity_hash(identity) & (cache->bucket_count - 1);
+
+  for (BFCacheEntry *entry = cache->buckets[bucket]; entry;
+       entry = entry->hash_next) {
+    if (!strcmp(entry->identity, identity)) {
+      if (cache->lru_head != entry) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+      }
+      return entry;
+    }
+  }
+
+  // Miss. Evict the least recently used entry if we're at budget.
+  if (cache->count >= cache->capacity) {
+    BFCacheEntry *victim = cache->lru_tail;
+    lru_unlink(cache, victim);
+    table_remove(cache, victim);
+    entry_free(victim);
+    cache->count--;
+  }
+
+  BFCacheEntry *entry = calloc(1, sizeof(*entry));
+  entry->identity = strdup(identity);
+  element_init_G2(entry->point, cache->params->pairing);
+  hash_to_point(entry->point, cache->params, entry->identity,
+                strlen(entry->identity));
+
+  entry->hash_next = cache->buckets[bucket];
+  cache->buckets[bucket] = entry;
+  lru_push_front(cache, entry);
+  cache->count++;
+
+  return entry;
+}
+
+element_ptr bf_key_cache_get(BFKeyCache *cache, const char *identity) {
+  return cache_lookup(cache, identity)->point;
+}
+
+element_ptr bf_key_cache_get_pairing(BFKeyCache *cache, const char *identity) {
+  BFCacheEntry *entry = cache_lookup(cache, identity);
+
+  if (!entry->has_pairing) {
+    element_init_GT(entry->pairing_value, cache->params->pairing);
+    BF_STATS_ENTER(PAIRING);
+    pairing_pp_apply(entry->pairing_value, entry->point,
+                     cache->params->P_pub_precomp);
+    BF_STATS_LEAVE(PAIRING);
+    entry->has_pairing = true;
+  }
+
+  return entry->pairing_value;
+}
+
+void bf_key_cache_flush(BFKeyCache *cache) {
+  if (!cache) {
+    return;
+  }
+
+  for (BFCacheEntry *entry = cache->lru_head; entry;) {
+    BFCacheEntry *next = entry->lru_next;
+    entry_free(entry);
+    entry = next;
+  }
+  memset(cache->buckets, 0, cache->bucket_count * sizeof(*cache->buckets));
+  cache->lru_head = cache->lru_tail = NULL;
+  cache->count = 0;
+}
+
+size_t bf_key_cache_count(BFKeyCache *cache) { return cache->count; }
+
+void bf_key_cache_free(BFKeyCache *cache) {
+  if (!cache) {
+    return;
+  }
+
+  for (BFCacheEntry *entry = cache->lru_head; entry;) {
+    BFCacheEntry *next = entry->lru_next;
+    entry_free(entry);
+    entry = next;
+  }
+  free(cache->buckets);
+  free(cache);
+}
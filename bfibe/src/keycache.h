@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#pragma once
+
+/*
+ * An LRU cache mapping identity strings to their hashed points in G2.
+ * Servers encrypt to a small working set of addresses over and over,
+ * so caching the hash-and-map-to-curve step saves one of the most
+ * expensive operations in the encrypt path.
+ *
+ * The cache is not thread-safe; attach one per BFPublicParameters.
+ */
+typedef struct BFKeyCache BFKeyCache;
+
+/*
+ * Create a cache holding at most capacity identity points.
+ */
+BFKeyCache *bf_key_cache_new(BFPublicParameters *params, size_t capacity);
+
+/*
+ * Look up the G2 point for an identity, computing and caching it on a
+ * miss. The returned element is owned by the cache and must be treated
+ * as read-only; it stays valid until the entry is evicted, so use it
+ * before the next lookup.
+ */
+element_ptr bf_key_cache_get(BFKeyCache *cache, const char *identity);
+
+/*
+ * Look up the pairing value e(Q_id, P_pub) for an identity, computing
+ * and caching it on a miss. Steady-state encryption to a cached address
+ * raises this value to the per-message exponent instead of running the
+ * pairing. Same ownership rules as bf_key_cache_get.
+ */
+element_ptr bf_key_cache_get_pairing(BFKeyCache *cache, const char *identity);
+
+/*
+ * Drop every entry. Must be called whenever P_pub changes, since the
+ * cached pairing values depend on it.
+ */
+void bf_key_cache_flush(BFKeyCache *cache);
+
+/*
+ * Number of entries currently cached.
+ */
+size_t bf_key_cache_count(BFKeyCache *cache);
+
+void bf_key_cache_free(BFKeyCache *cache);
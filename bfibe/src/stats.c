@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include "bfibe.h"
+#include "stats.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Each thread owns a counter block, registered in a global list the
+ * first time the thread records anything. Snapshots walk the list and
+ * sum; the reads race with recording, but a torn 64-bit counter read
+ * merely skews one sample of monitoring output. Blocks are never
+ * freed, so totals survive their threads.
+ */
+
+#ifdef BFIBE_STATS
+
+typedef struct BFStatsBlock {
+  uint64_t counts[BF_STAT_OP_COUNT];
+  uint64_t nanos[BF_STAT_OP_COUNT];
+  struct BFStatsBlock *next;
+} BFStatsBlock;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static BFStatsBlock *registry;
+static _Thread_local BFStatsBlock *tls_block;
+
+uint64_t bf_stats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void bf_stats_record(BFStatOp op, uint64_t nanos) {
+  BFStatsBlock *block = tls_block;
+  if (!block) {
+    block = calloc(1, sizeof(*block));
+    pthread_mutex_lock(&registry_lock);
+    block->next = registry;
+    registry = block;
+    pthread_mutex_unlock(&registry_lock);
+    tls_block = block;
+  }
+  block->counts[op]++;
+  block->nanos[op] += nanos;
+}
+
+int bf_stats_snapshot(unsigned long long *op_counts,
+                      unsigned long long *op_nanos) {
+  memset(op_counts, 0, BF_STAT_OP_COUNT * sizeof(*op_counts));
+  memset(op_nanos, 0, BF_STAT_OP_COUNT * sizeof(*op_nanos));
+
+  pthread_mutex_lock(&registry_lock);
+  for (BFStatsBlock *block = registry; block; block = block->next) {
+    for (int op = 0; op < BF_STAT_OP_COUNT; op++) {
+      op_counts[op] += block->counts[op];
+      op_nanos[op] += block->nanos[op];
+    }
+  }
+  pthread_mutex_unlock(&registry_lock);
+
+  return BF_STAT_OP_COUNT;
+}
+
+void bf_stats_reset(void) {
+  pthread_mutex_lock(&registry_lock);
+  for (BFStatsBlock *block = registry; block; block = block->next) {
+    memset(block->counts, 0, sizeof(block->counts));
+    memset(block->nanos, 0, sizeof(block->nanos));
+  }
+  pthread_mutex_unlock(&registry_lock);
+}
+
+int bf_stats_enabled(void) { return 1; }
+
+#else
+
+int bf_stats_snapshot(unsigned long long *op_counts,
+                      unsigned long long *op_nanos) {
+  memset(op_counts, 0, BF_STAT_OP_COUNT * sizeof(*op_counts));
+  memset(op_nanos, 0, BF_STAT_OP_COUNT * sizeof(*op_nanos));
+  return BF_STAT_OP_COUNT;
+}
+
+void bf_stats_reset(void) {}
+
+int bf_stats_enabled(void) { return 0; }
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#pragma once
+
+/*
+ * Optional hot-path instrumentation. Build with -DBFIBE_STATS to count
+ * the major operations and accumulate their wall time; without it the
+ * macros expand to nothing and bf_stats_snapshot reports zeros.
+ *
+ * Counters are kept per thread and summed on snapshot, so recording is
+ * two thread-local additions plus a clock read and never contends.
+ */
+typedef enum {
+  BF_STAT_ENCRYPT,
+  BF_STAT_DECRYPT,
+  BF_STAT_KEYGEN,
+  BF_STAT_PAIRING,
+  BF_STAT_GT_POW,
+  BF_STAT_HASH_TO_POINT,
+  BF_STAT_SERIALIZE,
+  BF_STAT_PARSE,
+  BF_STAT_OP_COUNT
+} BFStatOp;
+
+#ifdef BFIBE_STATS
+
+uint64_t bf_stats_now(void);
+void bf_stats_record(BFStatOp op, uint64_t nanos);
+
+/*
+ * Bracket an operation: BF_STATS_ENTER(ENCRYPT) ... BF_STATS_LEAVE(ENCRYPT).
+ * Early-exit paths between the two are simply not recorded.
+ */
+#define BF_STATS_ENTER(op) uint64_t bf_stats_start_##op = bf_stats_now()
+#define BF_STATS_LEAVE(op)                                                     \
+  bf_stats_record(BF_STAT_##op, bf_stats_now() - bf_stats_start_##op)
+
+#else
+
+#define BF_STATS_ENTER(op) ((void)0)
+#define BF_STATS_LEAVE(op) ((void)0)
+
+#endif
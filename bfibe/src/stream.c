@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#include "bfibe.h"
+#include "xor.h"
+#include <openssl/rand.h>
+#include <string.h>
+
+/*
+ * Streaming encryption for payloads too large to hold in memory.
+ *
+ * bf_encrypt needs the whole plaintext up front because the exponent l
+ * is derived from its hash, so the header cannot be emitted until the
+ * last byte has been seen. The streaming format sidesteps that by
+ * IBE-wrapping a fresh random content key with a regular bf_encrypt --
+ * the small message the scheme was designed for -- and masking the
+ * payload with the counter-mode keystream expanded from that key, one
+ * hash block at a time. Memory use is a few hash blocks regardless of
+ * payload size, and ciphertext can be emitted as fast as plaintext
+ * arrives.
+ *
+ * The header is verified on decrypt through the usual consistency
+ * check, but the payload itself carries no tag: as with
+ * bf_decrypt_unverified, integrity of the plaintext is the higher
+ * layer's job.
+ *
+ * Layout: {'B','F','S',1} | u32 wrapped_len | IBE-wrapped content key,
+ * followed by the masked payload with no framing of its own.
+ */
+
+static const uint8_t STREAM_MAGIC[4] = {'B', 'F', 'S', 1};
+static const size_t STREAM_KEY_BYTES = 32;
+
+static void write_u32(uint8_t **writeptr, uint32_t value) {
+  (*writeptr)[0] = value & 0xff;
+  (*writeptr)[1] = (value >> 8) & 0xff;
+  (*writeptr)[2] = (value >> 16) & 0xff;
+  (*writeptr)[3] = (value >> 24) & 0xff;
+  *writeptr += 4;
+}
+
+static uint32_t read_u32(uint8_t **readptr) {
+  uint32_t value = (*readptr)[0] | ((*readptr)[1] << 8) |
+                   ((*readptr)[2] << 16) | ((uint32_t)(*readptr)[3] << 24);
+  *readptr += 4;
+  return value;
+}
+
+/*
+ * Keys the keystream off the content key, mirroring hash_to_bytes_ctr:
+ * block i is hashfcn(hashfcn(key) || i). The counter starts exhausted
+ * so the first update call generates block 0.
+ */
+static void stream_setup(BFStream *stream, BFPublicParameters *params,
+                         uint8_t *content_key) {
+  size_t hlen = params->security.hashlen;
+
+  stream->params = params;
+  stream->block_input = malloc(hlen + 4);
+  stream->block = malloc(hlen);
+  params->security.hashfcn(content_key, STREAM_KEY_BYTES, stream->block_input);
+  stream->block_used = hlen;
+  stream->counter = 0;
+}
+
+size_t bf_stream_encrypt_init(BFStream *stream, BFPublicParameters *params,
+                              char *address, uint8_t **header_out) {
+  uint8_t content_key[STREAM_KEY_BYTES];
+  if (!RAND_bytes(content_key, STREAM_KEY_BYTES)) {
+    return 0;
+  }
+
+  BFEncryptScratch scratch;
+  bf_encrypt_scratch_init(&scratch, params);
+  BFMessage wrapped;
+  bool ok = bf_encrypt_to_address(&wrapped, &scratch, address, content_key,
+                                  STREAM_KEY_BYTES);
+  bf_encrypt_scratch_clear(&scratch);
+  if (!ok) {
+    return 0;
+  }
+
+  uint8_t *wrapped_bytes;
+  size_t wrapped_len = bf_message_to_bytes(&wrapped_bytes, params, &wrapped);
+  element_clear(wrapped.U);
+  free(wrapped.V);
+  free(wrapped.W);
+
+  size_t header_len = sizeof(STREAM_MAGIC) + 4 + wrapped_len;
+  uint8_t *header = malloc(header_len);
+  uint8_t *writeptr = header;
+  memcpy(writeptr, STREAM_MAGIC, sizeof(STREAM_MAGIC));
+  writeptr += sizeof(STREAM_MAGIC);
+  write_u32(&writeptr, wrapped_len);
+  memcpy(writeptr, wrapped_bytes, wrapped_len);
+  free(wrapped_bytes);
+
+  stream_setup(stream, params, content_key);
+  memset(content_key, 0, STREAM_KEY_BYTES);
+
+  *header_out = header;
+  return header_len;
+}
+
+bool bf_stream_decrypt_init(BFStream *stream, BFPublicParameters *params,
+                            element_t private_key, uint8_t *header,
+                            size_t header_len, size_t *header_used) {
+  if (header_len < sizeof(STREAM_MAGIC) + 4 ||
+      memcmp(header, STREAM_MAGIC, sizeof(STREAM_MAGIC))) {
+    return false;
+  }
+  uint8_t *readptr = header + sizeof(STREAM_MAGIC);
+  uint32_t wrapped_len = read_u32(&readptr);
+  if (sizeof(STREAM_MAGIC) + 4 + (size_t)wrapped_len > header_len) {
+    return false;
+  }
+
+  BFMessage wrapped;
+  if (!bf_message_from_bytes_view(readptr, wrapped_len, params, &wrapped)) {
+    return false;
+  }
+  if (wrapped.length != STREAM_KEY_BYTES) {
+    element_clear(wrapped.U);
+    return false;
+  }
+
+  uint8_t content_key[STREAM_KEY_BYTES];
+  bool ok = bf_decrypt(content_key, params, private_key, &wrapped);
+  element_clear(wrapped.U);
+  if (!ok) {
+    return false;
+  }
+
+  stream_setup(stream, params, content_key);
+  memset(content_key, 0, STREAM_KEY_BYTES);
+
+  *header_used = sizeof(STREAM_MAGIC) + 4 + wrapped_len;
+  return true;
+}
+
+void bf_stream_update(BFStream *stream, uint8_t *output, void *input,
+                      size_t len) {
+  uint8_t *in = input;
+  size_t hlen = stream->params->security.hashlen;
+  HashFn hashfcn = stream->params->security.hashfcn;
+
+  size_t done = 0;
+  while (done < len) {
+    if (stream->block_used == hlen) {
+      stream->block_input[hlen] = (stream->counter >> 24) & 0xff;
+      stream->block_input[hlen + 1] = (stream->counter >> 16) & 0xff;
+      stream->block_input[hlen + 2] = (stream->counter >> 8) & 0xff;
+      stream->block_input[hlen + 3] = stream->counter & 0xff;
+      hashfcn(stream->block_input, hlen + 4, stream->block);
+      stream->block_used = 0;
+      stream->counter++;
+    }
+
+    size_t n = len - done;
+    if (n > hlen - stream->block_used) {
+      n = hlen - stream->block_used;
+    }
+    if (output + done != in + done) {
+      memmove(output + done, in + done, n);
+    }
+    xor_bytes(output + done, stream->block + stream->block_used, n);
+    done += n;
+    stream->block_used += n;
+  }
+}
+
+void bf_stream_clear(BFStream *stream) {
+  size_t hlen = stream->params->security.hashlen;
+  // block_input holds the hashed content key; wipe both buffers.
+  memset(stream->block_input, 0, hlen + 4);
+  memset(stream->block, 0, hlen);
+  free(stream->block_input);
+  free(stream->block);
+  stream->params = NULL;
+}
@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2019-2020 SRI International.
+ * All rights reserved.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * XOR src into dst (dst[i] ^= src[i] for i < len) at memory bandwidth.
+ * Uses AVX2 or SSE2 on x86 (picked at runtime), NEON on ARM, and a
+ * word-wide scalar loop everywhere else. The buffers may not overlap.
+ */
+void xor_bytes(uint8_t *dst, const uint8_t *src, size_t len);
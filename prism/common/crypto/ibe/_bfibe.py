@@ -1,10 +1,270 @@
 #  Copyright (c) 2019-2023 SRI International.
 
-# auto-generated file
-import _cffi_backend
-
-ffi = _cffi_backend.FFI('_bfibe',
-    _version = 0x2601,
-    _types = b'\x00\x00\x05\x0D\x00\x00\x31\x03\x00\x00\x00\x0F\x00\x00\x05\x0D\x00\x00\x01\x11\x00\x00\x30\x03\x00\x00\x05\x11\x00\x00\x00\x0F\x00\x00\x05\x0D\x00\x00\x01\x11\x00\x00\x01\x11\x00\x00\x05\x11\x00\x00\x00\x0F\x00\x00\x01\x0D\x00\x00\x30\x03\x00\x00\x00\x0F\x00\x00\x01\x0D\x00\x00\x01\x11\x00\x00\x05\x11\x00\x00\x01\x11\x00\x00\x07\x01\x00\x00\x14\x03\x00\x00\x00\x0F\x00\x00\x01\x0D\x00\x00\x01\x11\x00\x00\x0E\x11\x00\x00\x00\x0F\x00\x00\x01\x0D\x00\x00\x01\x11\x00\x00\x01\x11\x00\x00\x00\x0F\x00\x00\x01\x0D\x00\x00\x01\x11\x00\x00\x01\x11\x00\x00\x01\x11\x00\x00\x07\x01\x00\x00\x15\x11\x00\x00\x00\x0F\x00\x00\x31\x0D\x00\x00\x07\x01\x00\x00\x01\x03\x00\x00\x28\x11\x00\x00\x00\x0F\x00\x00\x31\x0D\x00\x00\x01\x11\x00\x00\x28\x11\x00\x00\x28\x11\x00\x00\x00\x0F\x00\x00\x02\x01\x00\x00\x00\x01',
-    _globals = (b'\x00\x00\x1B\x23add_public',0,b'\x00\x00\x03\x23add_secret',0,b'\x00\x00\x1F\x23decrypt_ibe',0,b'\x00\x00\x10\x23encrypt_ibe',0,b'\x00\x00\x00\x23format_private_key',0,b'\x00\x00\x00\x23format_system_params',0,b'\x00\x00\x00\x23format_system_secret',0,b'\x00\x00\x08\x23generate_private_key',0,b'\x00\x00\x2B\x23generate_shard',0,b'\x00\x00\x26\x23generate_system',0,b'\x00\x00\x17\x23parse_private_key',0,b'\x00\x00\x0D\x23parse_system_params',0,b'\x00\x00\x0D\x23parse_system_secret',0),
-)
+# auto-generated from bfibe/include/api.h by boneh_franklin.build_api()
+from cffi import FFI
+
+ffi = FFI()
+ffi.cdef(r'''
+/*
+** Generate a new IBE system at the given security level. Fills in pointers to the system parameters and the system secret.
+** Security level is between 1 and 5, and should be at least 3 in production. More details in src/security.c.
+*/
+void generate_system(int security_level, void** system_out, void**secret_out);
+
+/*
+** Bank-backed system generation. The parameter bank (see the genparambank
+** tool) holds pregenerated curves per security level, so creating a fresh
+** system skips the prime search that takes seconds to minutes at the higher
+** levels; the generator, secret, and P_pub are still drawn fresh per system.
+** generate_system_from_bank returns nonzero on success; add_system_to_bank
+** appends a system's curve to the bank, creating the file if needed.
+*/
+int generate_system_from_bank(char *bank_path, int security_level, void **system_out, void **secret_out);
+int add_system_to_bank(void *system, char *bank_path);
+
+/*
+** Generate a new IBE shard for an existing system, with the same parameters except
+** for the secret s and the public parameter P_pub.
+*/
+void generate_shard(void *base_system, void **system_out, void **secret_out);
+
+/*
+** Utilities for converting secret keys to and from strings.
+*/
+char *format_system_secret(void* secret);
+void *parse_system_secret(const char* secret_string);
+
+/*
+** Utilities for converting system params to and from strings.
+*/
+char *format_system_params(void* system);
+void *parse_system_params(const char* param_string);
+
+/*
+** Binary forms of the system params. Fixed-width fields parse an order of magnitude
+** faster than the decimal text format and produce smaller registration blobs.
+** format_system_params_binary fills out_length and returns a malloc'd blob;
+** parse_system_params_binary returns NULL if the blob is malformed.
+*/
+void *format_system_params_binary(void *system, int *out_length);
+void *parse_system_params_binary(void *params_blob, int blob_length);
+
+/*
+** Save the binary parameter format to a file and load it back by memory-mapping
+** the file read-only. Node processes on one host that load the same file share
+** a single page-cache copy and skip the text parse at startup. save returns
+** nonzero on success; map returns NULL on failure.
+*/
+int save_system_params(void *system, char *path);
+void *map_system_params(char *path);
+
+/*
+** Utilities for generating and loading private keys.
+*/
+char *generate_private_key(void* system, void* secret, char* address);
+char *format_private_key(void *private_key);
+void *parse_private_key(void *system, const char* key_string);
+
+/*
+** Parses committee key shards and combines them into one ready-to-use private
+** key handle in a single pass: each shard is parsed once and accumulated in G2,
+** with no intermediate sum ever formatted back to a string. Equivalent to
+** folding the shards through sum_secrets and parsing the result.
+*/
+void *parse_private_key_multi(void *system, char **key_strings, int key_count);
+
+/*
+** Binary forms of private keys, built on element_to_bytes/element_from_bytes.
+** Much cheaper than the base-10 string forms (no radix conversion) and ~2.4x
+** smaller; the string forms above are kept for compatibility.
+** parse_private_key_bytes returns NULL if key_length doesn't match the curve.
+*/
+void *generate_private_key_bytes(void *system, void *secret, char *address, int *out_length);
+
+/*
+** Issue binary private keys for a whole registration burst in one call. The
+** group element is initialized once and reused, and the keys are packed into a
+** single malloc'd buffer at a fixed stride of key_length_out bytes; slice entry
+** i at i * key_length_out. Each slice parses with parse_private_key_bytes.
+*/
+void *generate_private_keys_batch(void *system, void *secret, char **addresses,
+                                  int address_count, int *key_length_out);
+void *format_private_key_bytes(void *private_key, int *out_length);
+void *parse_private_key_bytes(void *system, void *key_bytes, int key_length);
+
+/*
+** The encryption and decryption functions.
+*/
+void *encrypt_ibe(void *system, char* address, void *message, int message_len, int* out_length);
+void *decrypt_ibe(void *system, void *key, void *ciphertext, int ciphertext_len, int* out_length);
+
+/*
+ * As decrypt_ibe, but skips the ciphertext consistency check. Only for
+ * envelopes that are authenticated again at a higher layer.
+ */
+void *decrypt_ibe_unverified(void *system, void *key, void *ciphertext,
+                             int ciphertext_len, int *out_length);
+
+/*
+** Hybrid mode. The payload is encrypted with AES-256-GCM under a fresh random
+** key and only the 32-byte key is IBE-wrapped, so one native call handles a
+** payload of any size and authentication comes from the GCM tag. The two calls
+** are inverses; decrypt returns NULL if the tag does not verify.
+*/
+void *encrypt_ibe_hybrid(void *system, char *address, void *message, int message_len, int *out_length);
+void *decrypt_ibe_hybrid(void *system, void *key, void *ciphertext, int ciphertext_len, int *out_length);
+
+/*
+ * Streaming encrypt/decrypt for large payloads: constant memory,
+ * ciphertext emitted chunk by chunk. create_encrypt_stream returns a
+ * handle and a malloc'd header that must precede the payload;
+ * create_decrypt_stream consumes that header (reporting how many bytes
+ * it used) and returns NULL if it fails verification. stream_update
+ * masks len bytes in either direction; output may equal input.
+ */
+void *create_encrypt_stream(void *system, char *address, void **header_out,
+                            int *header_len);
+void *create_decrypt_stream(void *system, void *key, void *header,
+                            int header_len, int *header_used);
+int stream_update(void *stream, void *output, void *input, int len);
+void free_stream(void *stream);
+
+/*
+** Arena-backed variants for burst workloads. All per-message buffers — V/W
+** scratch, the wire buffer, decrypted plaintext — are carved from the arena
+** with a pointer bump instead of malloc, and reset_arena reclaims everything
+** in O(1) once the caller has copied the results out. Buffers returned by the
+** _arena entry points belong to the arena: never free() them, and treat them
+** as invalid after the next reset. One arena per thread or per batch.
+*/
+void *create_arena(int initial_capacity);
+void reset_arena(void *arena);
+void destroy_arena(void *arena);
+void *encrypt_ibe_arena(void *system, void *arena, char* address, void *message,
+                        int message_len, int* out_length);
+void *decrypt_ibe_arena(void *system, void *key, void *arena, void *ciphertext,
+                        int ciphertext_len, int* out_length);
+
+/*
+** Zero-copy variants that write into a caller-provided buffer instead of returning a
+** fresh allocation, so cffi callers can decrypt/encrypt straight into preallocated
+** Python buffers. ibe_ciphertext_length() gives the exact ciphertext size for a
+** plaintext length; a decrypted plaintext is never longer than its ciphertext.
+** Both return the number of bytes written, or -1 if the buffer is too small or the
+** input is malformed.
+*/
+int ibe_ciphertext_length(void *system, int message_len);
+int encrypt_ibe_into(void *system, char *address, void *message, int message_len,
+                     void *out, int out_capacity);
+int decrypt_ibe_into(void *system, void *key, void *ciphertext, int ciphertext_len,
+                     void *out, int out_capacity);
+
+/*
+** Opt new ciphertexts into the counter-mode keystream, whose blocks are
+** independent hashes instead of a serial chain. The mode is recorded in each
+** ciphertext, so decryption handles both formats regardless of this setting —
+** but only enable it once every receiver in the deployment can parse it.
+*/
+void enable_ctr_keystream(void *system, int enabled);
+
+/*
+** Set the entry budget of the identity hash point cache used during encryption.
+** Systems created through this API get a cache with a default budget; pass 0 to disable.
+*/
+void configure_key_cache(void *system, int max_entries);
+
+/*
+** Encrypt a batch of messages in one call, amortizing element setup across the batch.
+** Fills ciphertexts_out[i] with a malloc'd ciphertext and lengths_out[i] with its size.
+** Returns the number of messages successfully encrypted; entries past that are untouched.
+** Touches no global or interpreter state, so cffi callers can release the GIL around it.
+*/
+int encrypt_ibe_batch(void *system, char **addresses, void **messages, int *message_lengths,
+                      int message_count, void **ciphertexts_out, int *lengths_out);
+
+/*
+** Encrypt one payload to many recipients, sharing the per-message randomness and the
+** U = [l]P scalar multiplication so each extra recipient costs roughly one pairing.
+** Fills ciphertexts_out/lengths_out like encrypt_ibe_batch and returns the number produced.
+*/
+int encrypt_ibe_multi(void *system, char **addresses, int address_count,
+                      void *message, int message_len, void **ciphertexts_out, int *lengths_out);
+
+/*
+** Worker-pool engine for parallel IBE operations. PBC state is not safe for
+** concurrent use, so the engine gives each worker thread its own clone of the
+** pairing/curve state derived from the base system. thread_count <= 0 means
+** one worker per online core. Batch calls block until every item is done and
+** return the number of items that succeeded; they are safe to call with the
+** GIL released. Keys and secrets are passed in serialized form so each worker
+** can materialize them against its own pairing.
+**
+** parallel_encrypt follows encrypt_ibe_batch's fail-fast convention: after
+** the first failed item no further work is handed out, and failed or
+** unattempted output slots are NULL. Items already in flight on other workers
+** still finish, so successes are not necessarily a prefix of the batch.
+** parallel_decrypt processes every item, returning NULL slots for entries
+** that fail to parse or decrypt, matching the dropbox-poll use.
+*/
+void *create_parallel_engine(void *system, int thread_count);
+void destroy_parallel_engine(void *engine);
+int parallel_encrypt(void *engine, char **addresses, void **messages, int *message_lengths,
+                     int message_count, void **ciphertexts_out, int *lengths_out);
+int parallel_decrypt(void *engine, char *private_key, void **ciphertexts, int *ciphertext_lengths,
+                     int ciphertext_count, void **plaintexts_out, int *lengths_out);
+int parallel_generate_private_keys(void *engine, char *secret, char **addresses,
+                                   int address_count, char **keys_out);
+
+/*
+** Asynchronous service. submit_encrypt/submit_decrypt copy their inputs, queue
+** the operation for the worker pool, and return a nonzero ticket immediately;
+** poll_completions drains up to max finished operations into the caller's
+** arrays (ticket, malloc'd output or NULL on failure, length) and returns how
+** many it wrote. async_engine_fd exposes an eventfd that becomes readable when
+** completions are pending, for hooking into an event loop. Completions are
+** delivered in finish order, not submission order.
+*/
+void *create_async_engine(void *system, int thread_count);
+void destroy_async_engine(void *engine);
+int async_engine_fd(void *engine);
+unsigned long long submit_encrypt(void *engine, char *address, void *message, int message_len);
+unsigned long long submit_decrypt(void *engine, char *private_key, void *ciphertext, int ciphertext_len);
+int poll_completions(void *engine, unsigned long long *tickets, void **outputs,
+                     int *output_lengths, int max);
+
+/*
+** Reusable decryption contexts. Creating a context preprocesses the pairing on the
+** private key, so decrypting a long train of ciphertexts under one key pays the
+** setup cost once. The context borrows the system and key; free it before them.
+*/
+void *create_decryption_context(void *system, void *key);
+void *decrypt_ibe_with_context(void *context, void *ciphertext, int ciphertext_len, int* out_length);
+void free_decryption_context(void *context);
+
+/*
+** Instrumentation counters. When the library is built with -DBFIBE_STATS, the
+** major operations (in order: encrypt, decrypt, keygen, pairing, GT
+** exponentiation, hash-to-point, message serialize, message parse) are counted
+** and their wall time accumulated per thread. snapshot sums all threads into
+** the two caller arrays, which must each hold 8 entries, and returns the entry
+** count; without the build flag it reports zeros and bf_stats_enabled returns 0.
+*/
+int bf_stats_snapshot(unsigned long long *op_counts, unsigned long long *op_nanos);
+void bf_stats_reset(void);
+int bf_stats_enabled(void);
+
+/*
+** Functions for combining IBE shards.
+*/
+void *add_public(void *system1, void *system2);
+char *add_secret(void *system, char *secret1, char *secret2);
+
+/*
+** Array forms of the shard combiners. Each input is parsed once, the sum is
+** accumulated in place, and the result is serialized once at the end, instead
+** of a full parse/format round-trip per pairwise addition. sum_public returns
+** a new system; sum_secrets returns the combined key in serialized form.
+*/
+void *sum_public(void **systems, int system_count);
+char *sum_secrets(void *system, char **secrets, int secret_count);
+''')